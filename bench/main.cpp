@@ -0,0 +1,832 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "bench.hpp"
+#include "engine.hpp"
+#include "incremental.hpp"
+#include "server.hpp"
+#include "simd.hpp"
+#include "topology.hpp"
+#include "utils.hpp"
+
+// A scene and template to time: loaded from a data folder or generated
+struct Dataset
+{
+    std::string name;
+    Matrix S, T;
+};
+
+struct BenchOptions
+{
+    std::vector<std::string> folders;
+    std::vector<std::string> synthetic; // "SRxSC:TRxTC"
+    std::vector<std::string> engines = {"direct"}; // command-line names, reported as given
+    std::vector<Metric> metrics = {Metric::PCC, Metric::SSD};
+    std::vector<int> threads;           // empty: 1..cores
+    std::vector<Placement> placements = {Placement::None};
+    int warmup = 1;
+    int repetitions = 5;
+    unsigned seed = 1;
+    ElementWidth storage = ElementWidth::UInt8;
+    std::string json = "outputs/bench.json";
+    int verify = 0; // > 0: check the SIMD engine and batch matching on this many random cases instead of timing
+    int incremental = 0; // > 0: check IncrementalMatch over this many frames of dirty rectangles
+    int client = 0;      // > 0: check this many requests through a live match server
+};
+
+static std::vector<std::string> split_list(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// "1,2,4", "1-8" or "all"
+static std::vector<int> parse_threads(const std::string &list, int cores)
+{
+    std::vector<int> threads;
+    for (const auto &item : split_list(list))
+    {
+        size_t dash = item.find('-');
+        int first = item == "all" ? 1 : std::stoi(item.substr(0, dash));
+        int last = item == "all" ? cores : dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        if (first < 1 || last < first)
+        {
+            throw std::runtime_error("Invalid thread count: " + item);
+        }
+        for (int t = first; t <= last; ++t)
+        {
+            threads.push_back(t);
+        }
+    }
+    return threads;
+}
+
+// "16x16:2000x3000" -> {16, 16, 2000, 3000}
+static std::vector<int> parse_synthetic(const std::string &spec)
+{
+    int s_rows, s_cols, t_rows, t_cols;
+    char x1, colon, x2;
+    std::istringstream in(spec);
+    if (!(in >> s_rows >> x1 >> s_cols >> colon >> t_rows >> x2 >> t_cols) || x1 != 'x' || colon != ':' ||
+        x2 != 'x')
+    {
+        throw std::runtime_error("Invalid synthetic size (want SRxSC:TRxTC): " + spec);
+    }
+    return {s_rows, s_cols, t_rows, t_cols};
+}
+
+static void usage()
+{
+    std::cout << "Usage: benchmark [--data DIR,...] [--synthetic SRxSC:TRxTC,...] [--engines direct,simd,...]\n"
+                 "                 [--metrics pcc,ssd,sad,ncc] [--threads 1,2,4|1-8|all] [--warmup N] [--reps N]\n"
+                 "                 [--placements none,compact,scatter,physical,numa]\n"
+                 "                 [--storage int32|uint8|nibble] [--seed N] [--json FILE]\n"
+                 "       benchmark --verify [N] [--seed N]\n"
+                 "       benchmark --incremental [FRAMES] [--data DIR,...] [--synthetic SRxSC:TRxTC,...]\n"
+                 "                 [--metrics ...] [--threads N] [--storage ...] [--seed N]\n"
+                 "       benchmark --client [REQUESTS] [--metrics ...] [--threads N] [--seed N]\n";
+}
+
+static BenchOptions parse_bench_options(int argc, char *argv[], int cores)
+{
+    BenchOptions options;
+    for (int k = 1; k < argc; ++k)
+    {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if (arg == "--help" || arg == "-h")
+        {
+            usage();
+            std::exit(0);
+        }
+        else if (arg == "--data" && has_value)
+        {
+            for (const auto &folder : split_list(argv[++k]))
+            {
+                options.folders.push_back(folder);
+            }
+        }
+        else if (arg == "--synthetic" && has_value)
+        {
+            for (const auto &spec : split_list(argv[++k]))
+            {
+                options.synthetic.push_back(spec);
+            }
+        }
+        else if (arg == "--engines" && has_value)
+        {
+            options.engines = split_list(argv[++k]);
+        }
+        else if (arg == "--metrics" && has_value)
+        {
+            options.metrics = parse_metrics(argv[++k]);
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            options.threads = parse_threads(argv[++k], cores);
+        }
+        else if (arg == "--placements" && has_value)
+        {
+            options.placements.clear();
+            for (const auto &name : split_list(argv[++k]))
+            {
+                options.placements.push_back(parse_placement(name));
+            }
+        }
+        else if (arg == "--warmup" && has_value)
+        {
+            options.warmup = std::max(0, std::stoi(argv[++k]));
+        }
+        else if (arg == "--reps" && has_value)
+        {
+            options.repetitions = std::max(1, std::stoi(argv[++k]));
+        }
+        else if (arg == "--storage" && has_value)
+        {
+            options.storage = parse_element_width(argv[++k]);
+        }
+        else if (arg == "--seed" && has_value)
+        {
+            options.seed = std::stoul(argv[++k]);
+        }
+        else if (arg == "--verify")
+        {
+            options.verify = 1000;
+            if (has_value && std::isdigit(static_cast<unsigned char>(argv[k + 1][0])))
+            {
+                options.verify = std::max(1, std::stoi(argv[++k]));
+            }
+        }
+        else if (arg == "--incremental")
+        {
+            options.incremental = 50;
+            if (has_value && std::isdigit(static_cast<unsigned char>(argv[k + 1][0])))
+            {
+                options.incremental = std::max(1, std::stoi(argv[++k]));
+            }
+        }
+        else if (arg == "--client")
+        {
+            options.client = 300;
+            if (has_value && std::isdigit(static_cast<unsigned char>(argv[k + 1][0])))
+            {
+                options.client = std::max(1, std::stoi(argv[++k]));
+            }
+        }
+        else if (arg == "--json" && has_value)
+        {
+            options.json = argv[++k];
+        }
+        else
+        {
+            usage();
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (options.verify == 0 && options.incremental == 0 && options.client == 0 && options.folders.empty() &&
+        options.synthetic.empty())
+    {
+        throw std::runtime_error("Nothing to benchmark: give --data and/or --synthetic");
+    }
+    for (const auto &name : options.engines)
+    {
+        if (parse_engine(name) == Engine::Stream)
+        {
+            throw std::runtime_error("The stream engine reads T from disk and is not benchmarked here");
+        }
+    }
+    if (options.threads.empty())
+    {
+        options.threads = parse_threads("all", cores);
+    }
+    return options;
+}
+
+static std::vector<Dataset> load_datasets(const BenchOptions &options, ThreadPool &pool)
+{
+    std::vector<Dataset> datasets;
+    for (const auto &folder : options.folders)
+    {
+        std::string s_file, t_file;
+        int s_rows, s_cols, t_rows, t_cols;
+        find_files(folder, s_file, t_file, s_rows, s_cols, t_rows, t_cols);
+        Dataset dataset{folder, {}, {}};
+        read_arrays(s_file, t_file, s_rows, s_cols, t_rows, t_cols, dataset.S, dataset.T, options.storage, &pool);
+        datasets.push_back(std::move(dataset));
+    }
+    for (size_t k = 0; k < options.synthetic.size(); ++k)
+    {
+        std::vector<int> size = parse_synthetic(options.synthetic[k]);
+        unsigned seed = options.seed + static_cast<unsigned>(k);
+        Dataset dataset{"synthetic/" + options.synthetic[k], {}, {}};
+        dataset.T = synthetic_matrix(size[2], size[3], options.storage, seed);
+        dataset.S = synthetic_template(dataset.T, size[0], size[1], seed);
+        datasets.push_back(std::move(dataset));
+    }
+    return datasets;
+}
+
+// Random pixels drawn from `levels` evenly spaced values in [0, 9]; one level gives
+// a constant matrix, whose zero variance PCC must report as 0
+static Matrix random_matrix(int rows, int cols, ElementWidth width, int levels, std::mt19937 &rng)
+{
+    Matrix m(rows, cols, width);
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int c = 0; c < cols; ++c)
+        {
+            int level = levels > 1 ? static_cast<int>(rng() % levels) : 0;
+            m.set(r, c, levels > 1 ? level * 9 / (levels - 1) : 7);
+        }
+    }
+    return m;
+}
+
+// Compare every SimdLevel the CPU supports against the scalar compute() on random
+// shapes: all element widths, column counts that leave 0-15 positions after the
+// last full vector, odd template widths (a half-filled byte pair per row), templates
+// wide enough to force the scalar fallback, and low-variance scenes full of ties.
+// Values must be bit-identical and tie sets equal. Returns the mismatch count.
+static int verify_simd(int cases, unsigned seed, ThreadPool &pool)
+{
+    const SimdLevel supported = detect_simd_level();
+    std::vector<SimdLevel> levels;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2})
+    {
+        if (level <= supported)
+        {
+            levels.push_back(level);
+        }
+        else
+        {
+            std::cout << "Skipping " << simd_level_name(level) << ": not supported by this CPU\n";
+        }
+    }
+
+    std::mt19937 rng(seed);
+    int mismatches = 0, checks = 0;
+    for (int n = 0; n < cases; ++n)
+    {
+        const ElementWidth width = static_cast<ElementWidth>(rng() % 3);
+        const Metric metric = rng() % 2 ? Metric::PCC : Metric::SSD;
+        const bool wide = n % 50 == 49; // 81 * S_cols > 32767: scalar fallback
+        const int S_rows = 1 + rng() % (wide ? 3 : 12);
+        const int S_cols = wide ? 405 + rng() % 20 : 1 + rng() % 33;
+        const int T_rows = S_rows + rng() % 40;
+        const int T_cols = S_cols - 1 + 16 * (rng() % 4) + 1 + rng() % 16; // max_j covers every remainder
+        const int scene_levels = n % 7 == 6 ? 1 + rng() % 2 : 10;
+
+        Matrix T = random_matrix(T_rows, T_cols, width, scene_levels, rng);
+        Matrix S = random_matrix(S_rows, S_cols, width, rng() % 5 ? 10 : 1 + rng() % 2, rng);
+        if (rng() % 2)
+        {
+            // Cut S from T so an exact match (and often ties) exists
+            const int i0 = rng() % (T_rows - S_rows + 1), j0 = rng() % (T_cols - S_cols + 1);
+            for (int r = 0; r < S_rows; ++r)
+            {
+                for (int c = 0; c < S_cols; ++c)
+                {
+                    S.set(r, c, T.at(i0 + r, j0 + c));
+                }
+            }
+        }
+
+        std::vector<std::pair<int, int>> expected_positions;
+        double expected_value;
+        compute(S, T, metric, expected_positions, expected_value);
+        std::sort(expected_positions.begin(), expected_positions.end());
+        for (SimdLevel level : levels)
+        {
+            std::vector<std::pair<int, int>> positions;
+            double value;
+            const int threads = 1 + rng() % std::max(pool.size(), 1);
+            compute_simd(S, T, metric, positions, value, threads, level, &pool);
+            std::sort(positions.begin(), positions.end());
+            ++checks;
+            if (value != expected_value || positions != expected_positions)
+            {
+                ++mismatches;
+                std::cout << "MISMATCH " << simd_level_name(level) << " " << metric_name(metric) << " "
+                          << element_width_name(width) << " S " << S_rows << "x" << S_cols << " T " << T_rows
+                          << "x" << T_cols << ": " << std::setprecision(17) << value << " (" << positions.size()
+                          << " positions) vs " << expected_value << " (" << expected_positions.size() << ")\n";
+            }
+        }
+    }
+    std::cout << "SIMD verification: " << checks << " checks over " << cases << " cases, " << mismatches
+              << " mismatches\n";
+    return mismatches;
+}
+
+// Match random template sets with compute_batch and check every template against its
+// own compute_parallel: mixed shapes (3x3 and 5x5 specialisations among them, some as
+// large as T, so tiles end where only some templates fit), every metric and width.
+// Values must be bit-identical and tie sets equal. Returns the mismatch count.
+static int verify_batch(int cases, unsigned seed, ThreadPool &pool)
+{
+    std::mt19937 rng(seed);
+    int mismatches = 0, checks = 0;
+    for (int n = 0; n < cases; ++n)
+    {
+        const ElementWidth width = static_cast<ElementWidth>(rng() % 3);
+        const Metric metric = static_cast<Metric>(rng() % 4);
+        const int T_rows = 1 + rng() % 60, T_cols = 1 + rng() % 80;
+        Matrix T = random_matrix(T_rows, T_cols, width, n % 5 == 4 ? 2 : 10, rng);
+
+        std::vector<Matrix> S;
+        std::vector<BatchTemplate> templates;
+        const int count = 1 + rng() % 6;
+        for (int k = 0; k < count; ++k)
+        {
+            int rows = 1 + rng() % std::min(T_rows, 12), cols = 1 + rng() % std::min(T_cols, 12);
+            switch (rng() % 6)
+            {
+            case 0:
+                rows = cols = 3;
+                break;
+            case 1:
+                rows = cols = 5;
+                break;
+            case 2:
+                rows = T_rows;
+                break;
+            default:
+                break;
+            }
+            rows = std::min(rows, T_rows);
+            cols = std::min(cols, T_cols);
+            S.push_back(random_matrix(rows, cols, width, 10, rng));
+            templates.push_back(prepare_template(S.back(), std::to_string(k)));
+        }
+
+        const int threads = 1 + rng() % std::max(pool.size(), 1);
+        std::vector<TemplateResult> results;
+        compute_batch(templates, T, metric, results, threads, rng() % 2 ? &pool : nullptr);
+        for (int k = 0; k < count; ++k)
+        {
+            std::vector<std::pair<int, int>> positions;
+            double value;
+            compute_parallel(S[k], T, metric, positions, value, threads, &pool);
+            std::sort(positions.begin(), positions.end());
+            ++checks;
+            if (results[k].best_value != value || results[k].best_positions != positions)
+            {
+                ++mismatches;
+                std::cout << "MISMATCH batch " << metric_name(metric) << " " << element_width_name(width) << " S "
+                          << S[k].rows() << "x" << S[k].cols() << " T " << T_rows << "x" << T_cols << ": "
+                          << std::setprecision(17) << results[k].best_value << " ("
+                          << results[k].best_positions.size() << " positions) vs " << value << " ("
+                          << positions.size() << ")\n";
+            }
+        }
+    }
+    std::cout << "Batch verification: " << checks << " templates over " << cases << " cases, " << mismatches
+              << " mismatches\n";
+    return mismatches;
+}
+
+// Repaint the part of `rect` inside T with random pixels
+static void paint_rect(Matrix &T, const DirtyRect &rect, int levels, std::mt19937 &rng)
+{
+    for (int r = std::max(rect.r0, 0); r < std::min(rect.r1, T.rows()); ++r)
+    {
+        for (int c = std::max(rect.c0, 0); c < std::min(rect.c1, T.cols()); ++c)
+        {
+            T.set(r, c, levels > 1 ? static_cast<int>(rng() % levels) * 9 / (levels - 1) : 7);
+        }
+    }
+}
+
+// One frame's worth of changes: a patch over the current best window (the best must
+// move elsewhere, or stay through a tie), two overlapping rectangles, and one that
+// hangs over the border of T and is clipped. Every 4th frame also pastes S somewhere,
+// so an improved best has to be picked up too.
+static std::vector<DirtyRect> dirty_frame(Matrix &T, const Matrix &S, const IncrementalMatch &match, int levels,
+                                          std::mt19937 &rng, int frame)
+{
+    const int T_rows = T.rows(), T_cols = T.cols(), S_rows = S.rows(), S_cols = S.cols();
+    auto span = [&rng](int limit) { return 1 + static_cast<int>(rng() % std::max(limit, 1)); };
+    std::vector<DirtyRect> dirty;
+
+    const auto &best = match.best_positions()[rng() % match.best_positions().size()];
+    const int r0 = best.first + static_cast<int>(rng() % S_rows), c0 = best.second + static_cast<int>(rng() % S_cols);
+    dirty.push_back({r0, r0 + span(S_rows), c0, c0 + span(S_cols)});
+
+    const int a_rows = span(2 * S_rows), a_cols = span(2 * S_cols);
+    const int ar = static_cast<int>(rng() % T_rows), ac = static_cast<int>(rng() % T_cols);
+    dirty.push_back({ar, ar + a_rows, ac, ac + a_cols});
+    const int br = ar + static_cast<int>(rng() % a_rows), bc = ac + static_cast<int>(rng() % a_cols);
+    dirty.push_back({br, br + span(2 * S_rows), bc, bc + span(2 * S_cols)});
+
+    // 四邊輪流超出 T
+    const int e_rows = span(S_rows + 4), e_cols = span(S_cols + 4);
+    const int er = static_cast<int>(rng() % T_rows), ec = static_cast<int>(rng() % T_cols);
+    switch (frame % 4)
+    {
+    case 0:
+        dirty.push_back({-e_rows / 2, e_rows - e_rows / 2, ec, ec + e_cols});
+        break;
+    case 1:
+        dirty.push_back({T_rows - e_rows / 2, T_rows + e_rows, ec, ec + e_cols});
+        break;
+    case 2:
+        dirty.push_back({er, er + e_rows, -e_cols / 2, e_cols - e_cols / 2});
+        break;
+    default:
+        dirty.push_back({er, er + e_rows, T_cols - e_cols / 2, T_cols + e_cols});
+        break;
+    }
+    for (const DirtyRect &rect : dirty)
+    {
+        paint_rect(T, rect, levels, rng);
+    }
+
+    if (frame % 4 == 3)
+    {
+        const int i0 = static_cast<int>(rng() % (T_rows - S_rows + 1));
+        const int j0 = static_cast<int>(rng() % (T_cols - S_cols + 1));
+        for (int r = 0; r < S_rows; ++r)
+        {
+            for (int c = 0; c < S_cols; ++c)
+            {
+                T.set(i0 + r, j0 + c, S.at(r, c));
+            }
+        }
+        dirty.push_back({i0, i0 + S_rows, j0, j0 + S_cols});
+    }
+    return dirty;
+}
+
+// Play `frames` frames of dirty rectangles over T and compare IncrementalMatch::update
+// with a fresh compute_parallel of the whole frame: values bit-identical, tie sets
+// equal. Prints the time of both. Returns the mismatch count.
+static int verify_incremental(const std::string &name, const Matrix &S, const Matrix &scene, Metric metric,
+                              int levels, int frames, int threads, std::mt19937 &rng, ThreadPool &pool)
+{
+    // 逐幀就地塗改：先深拷貝，不碰呼叫端（可能是唯讀 mmap）的緩衝區
+    Matrix T = scene.clone();
+    IncrementalMatch match(S, metric);
+    match.reset(T, threads, &pool);
+    const double windows = static_cast<double>(T.rows() - S.rows() + 1) * (T.cols() - S.cols() + 1);
+    double update_time = 0.0, full_time = 0.0, rescored = 0.0;
+    int mismatches = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        std::vector<DirtyRect> dirty = dirty_frame(T, S, match, levels, rng, frame);
+        IncrementalStats stats;
+        auto start = std::chrono::steady_clock::now();
+        match.update(T, dirty, threads, &pool, &stats);
+        auto middle = std::chrono::steady_clock::now();
+        std::vector<std::pair<int, int>> positions;
+        double value;
+        compute_parallel(S, T, metric, positions, value, threads, &pool);
+        auto end = std::chrono::steady_clock::now();
+        update_time += std::chrono::duration<double>(middle - start).count();
+        full_time += std::chrono::duration<double>(end - middle).count();
+        rescored += stats.rescored;
+
+        std::sort(positions.begin(), positions.end());
+        if (match.best_value() != value || match.best_positions() != positions)
+        {
+            ++mismatches;
+            std::cout << "MISMATCH " << name << " " << metric_name(metric) << " frame " << frame << ": "
+                      << std::setprecision(17) << match.best_value() << " (" << match.best_positions().size()
+                      << " positions) vs " << value << " (" << positions.size() << ")\n";
+        }
+    }
+    std::cout << std::left << std::setw(28) << name << std::setw(5) << metric_name(metric) << std::right
+              << std::fixed << std::setprecision(1) << std::setw(7) << 100.0 * rescored / (windows * frames)
+              << "% rescored" << std::setprecision(6) << std::setw(12) << update_time / frames << "s/update"
+              << std::setw(12) << full_time / frames << "s/full" << std::setw(6) << mismatches << " mismatches\n"
+              << std::defaultfloat;
+    return mismatches;
+}
+
+struct ServerThread
+{
+    const std::vector<Scene> *scenes = nullptr;
+    ThreadPool *pool = nullptr;
+    ServerOptions options;
+    std::string error; // serve() failed with this
+};
+
+static void *server_main(void *arg)
+{
+    ServerThread *server = static_cast<ServerThread *>(arg);
+    try
+    {
+        serve(*server->scenes, *server->pool, server->options);
+    }
+    catch (const std::exception &e)
+    {
+        server->error = e.what();
+    }
+    return nullptr;
+}
+
+// Round trip through a live server: serve() runs on a private socket in a thread of
+// its own, and MatchClient sends best-value, Top-K and threshold requests for cut and
+// random templates. Replies must equal compute_parallel (value bit-identical, tie set
+// equal) or compute_ranked (same list), and a Top-K request with k = 0 must be
+// refused. Returns the mismatch count.
+static int verify_client(int requests, unsigned seed, const std::vector<Metric> &metrics, int threads,
+                         ThreadPool &pool)
+{
+    std::mt19937 rng(seed);
+    std::vector<Scene> scenes;
+    scenes.push_back({"T1_120_160", random_matrix(120, 160, ElementWidth::UInt8, 10, rng)});
+    scenes.push_back({"T2_90_110", random_matrix(90, 110, ElementWidth::Nibble, 2, rng)}); // tie-heavy
+
+    // 伺服器用自己的執行緒池，與本執行緒的參考計算同時進行
+    ThreadPool server_pool(pool.size());
+    ServerThread server;
+    server.scenes = &scenes;
+    server.pool = &server_pool;
+    server.options.socket_path = "/tmp/benchmark-" + std::to_string(getpid()) + ".sock";
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, server_main, &server) != 0)
+    {
+        throw std::runtime_error("Could not start the match server thread");
+    }
+    std::unique_ptr<MatchClient> client;
+    for (int attempt = 0; !client; ++attempt)
+    {
+        try
+        {
+            client = std::make_unique<MatchClient>(server.options.socket_path);
+        }
+        catch (const std::runtime_error &)
+        {
+            if (attempt == 500)
+            {
+                throw std::runtime_error("Match server did not start on " + server.options.socket_path);
+            }
+            usleep(10000);
+        }
+    }
+
+    int mismatches = 0;
+    for (int n = 0; n < requests; ++n)
+    {
+        const Scene &scene = scenes[n % scenes.size()];
+        MatchRequest request;
+        request.scene = scene.name;
+        request.metric = metrics[n % metrics.size()];
+        request.rows = 2 + rng() % 6;
+        request.cols = 2 + rng() % 6;
+        Matrix S = random_matrix(request.rows, request.cols, ElementWidth::UInt8, 10, rng);
+        if (rng() % 2)
+        {
+            // Cut S from T so an exact match (and often ties) exists
+            const int i0 = rng() % (scene.T.rows() - request.rows + 1);
+            const int j0 = rng() % (scene.T.cols() - request.cols + 1);
+            for (int r = 0; r < request.rows; ++r)
+            {
+                for (int c = 0; c < request.cols; ++c)
+                {
+                    S.set(r, c, scene.T.at(i0 + r, j0 + c));
+                }
+            }
+        }
+        request.pixels.resize(static_cast<size_t>(request.rows) * request.cols);
+        for (int r = 0; r < request.rows; ++r)
+        {
+            S.unpack_row(r, 0, request.cols, request.pixels.data() + static_cast<size_t>(r) * request.cols);
+        }
+
+        std::vector<std::pair<int, int>> positions;
+        double value;
+        compute_parallel(S, scene.T, request.metric, positions, value, threads, &pool);
+        std::sort(positions.begin(), positions.end());
+        std::vector<ScoredPosition> ranked;
+        if (n % 3 == 1)
+        {
+            request.results.mode = ResultMode::TopK;
+            request.results.k = 1 + rng() % 8;
+            request.results.nms_radius = rng() % 3;
+        }
+        else if (n % 3 == 2)
+        {
+            request.results.mode = ResultMode::Threshold;
+            request.results.k = 64;
+            request.results.threshold = metric_find_max(request.metric) ? value - 0.3 : value + 40.0;
+            request.results.nms_radius = rng() % 3;
+        }
+        if (request.results.mode != ResultMode::Best)
+        {
+            compute_ranked(S, scene.T, request.metric, request.results, ranked, threads, &pool);
+        }
+
+        MatchReply reply = client->match(request);
+        bool same = reply.ok;
+        if (same && request.results.mode == ResultMode::Best)
+        {
+            std::vector<std::pair<int, int>> served;
+            for (const ScoredPosition &p : reply.positions)
+            {
+                served.push_back({p.i, p.j});
+            }
+            std::sort(served.begin(), served.end());
+            same = reply.best_value == value && served == positions;
+        }
+        else if (same)
+        {
+            same = reply.positions.size() == ranked.size();
+            for (size_t k = 0; same && k < ranked.size(); ++k)
+            {
+                same = reply.positions[k].value == ranked[k].value && reply.positions[k].i == ranked[k].i &&
+                       reply.positions[k].j == ranked[k].j;
+            }
+        }
+        if (!same)
+        {
+            ++mismatches;
+            std::cout << "MISMATCH request " << n << " " << scene.name << " " << metric_name(request.metric)
+                      << " mode " << static_cast<int>(request.results.mode) << ": "
+                      << (reply.ok ? "served " + std::to_string(reply.positions.size()) + " positions"
+                                   : "error " + reply.error)
+                      << "\n";
+        }
+    }
+
+    MatchRequest unbounded;
+    unbounded.scene = scenes.front().name;
+    unbounded.results.mode = ResultMode::TopK; // k = 0
+    unbounded.rows = unbounded.cols = 1;
+    unbounded.pixels = {1};
+    if (client->match(unbounded).ok)
+    {
+        ++mismatches;
+        std::cout << "MISMATCH: Top-K request with k = 0 was served\n";
+    }
+
+    client->shutdown_server();
+    pthread_join(thread, nullptr);
+    if (!server.error.empty())
+    {
+        throw std::runtime_error("Match server failed: " + server.error);
+    }
+    std::cout << "Client round-trip: " << requests << " requests, " << mismatches << " mismatches\n";
+    return mismatches;
+}
+
+// Warm up, then time options.repetitions runs of one engine/metric/thread count
+static void time_record(BenchRecord &record, Engine engine, Metric metric, const Matrix &S, const Matrix &T,
+                        const BenchOptions &options, ThreadPool &pool)
+{
+    const double windows = static_cast<double>(T.rows() - S.rows() + 1) * (T.cols() - S.cols() + 1);
+    // 暖身後再計時
+    for (int rep = 0; rep < options.warmup + options.repetitions; ++rep)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run_engine(engine, metric, S, T, record.best_positions, record.best_value, record.threads, &pool);
+        auto end = std::chrono::steady_clock::now();
+        if (rep >= options.warmup)
+        {
+            record.samples.push_back(std::chrono::duration<double>(end - start).count());
+        }
+    }
+    record.stats = summarize_samples(record.samples);
+    double median = std::max(record.stats.median, 1e-12);
+    record.windows_per_second = windows / median;
+    record.gb_per_second = T.bytes() / median / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    try
+    {
+        BenchOptions options = parse_bench_options(argc, argv, num_cores);
+        ThreadPool pool(num_cores);
+        if (options.verify > 0)
+        {
+            int mismatches = verify_simd(options.verify, options.seed, pool);
+            mismatches += verify_batch(options.verify, options.seed, pool);
+            return mismatches == 0 ? 0 : 1;
+        }
+        if (options.client > 0)
+        {
+            int mismatches =
+                verify_client(options.client, options.seed, options.metrics, options.threads.back(), pool);
+            return mismatches == 0 ? 0 : 1;
+        }
+        if (options.incremental > 0)
+        {
+            // Without --data/--synthetic: one scene per element width, the nibble one tie-heavy
+            std::mt19937 rng(options.seed);
+            std::vector<std::pair<Dataset, int>> scenes;
+            for (auto &dataset : load_datasets(options, pool))
+            {
+                scenes.push_back({std::move(dataset), 10});
+            }
+            if (scenes.empty())
+            {
+                scenes.push_back({{"random/16x16:300x400", {}, random_matrix(300, 400, ElementWidth::UInt8, 10, rng)}, 10});
+                scenes.push_back({{"random/5x5:130x200", {}, random_matrix(130, 200, ElementWidth::Nibble, 2, rng)}, 2});
+                scenes.push_back({{"random/3x7:70x90", {}, random_matrix(70, 90, ElementWidth::Int32, 10, rng)}, 10});
+                const int sizes[][2] = {{16, 16}, {5, 5}, {3, 7}};
+                for (size_t k = 0; k < scenes.size(); ++k)
+                {
+                    scenes[k].first.S = synthetic_template(scenes[k].first.T, sizes[k][0], sizes[k][1], options.seed);
+                }
+            }
+            int mismatches = 0;
+            for (const auto &scene : scenes)
+            {
+                for (Metric metric : options.metrics)
+                {
+                    mismatches += verify_incremental(scene.first.name, scene.first.S, scene.first.T, metric,
+                                                     scene.second, options.incremental, options.threads.back(), rng,
+                                                     pool);
+                }
+            }
+            std::cout << "Incremental verification: " << mismatches << " mismatches\n";
+            return mismatches == 0 ? 0 : 1;
+        }
+        std::cout << "Topology: " << Topology::detect().describe() << "\n";
+        std::vector<Dataset> datasets = load_datasets(options, pool);
+
+        std::vector<BenchRecord> records;
+        std::cout << std::fixed;
+        for (const auto &dataset : datasets)
+        {
+            const Matrix &S = dataset.S, &T = dataset.T;
+            std::cout << "\n" << dataset.name << ": S " << S.rows() << "x" << S.cols() << ", T " << T.rows()
+                      << "x" << T.cols() << " (" << element_width_name(T.width()) << ")\n";
+            std::cout << std::left << std::setw(10) << "engine" << std::setw(7) << "metric" << std::setw(10)
+                      << "placement" << std::right << std::setw(8) << "threads" << std::setw(12) << "min(s)"
+                      << std::setw(12) << "median(s)" << std::setw(12) << "p95(s)" << std::setw(12) << "stddev(s)" << std::setw(14) << "Mwin/s"
+                      << std::setw(10) << "GB/s" << "\n";
+            for (Placement placement : options.placements)
+            {
+                apply_placement(pool, placement);
+                // NUMA-local: 每種執行緒數各 first-touch 一份 T（不計時）
+                std::map<int, Matrix> local;
+                for (const auto &name : options.engines)
+                {
+                    Engine engine = parse_engine(name);
+                    for (Metric metric : options.metrics)
+                    {
+                        for (int threads : options.threads)
+                        {
+                            if (placement == Placement::NumaLocal && !local.count(threads))
+                            {
+                                local[threads] = node_local_copy(T, threads, &pool);
+                            }
+                            const Matrix &T_run = placement == Placement::NumaLocal ? local[threads] : T;
+                            BenchRecord record;
+                            record.dataset = dataset.name;
+                            record.engine = name;
+                            record.method = metric_name(metric);
+                            record.placement = placement_name(placement);
+                            record.S_rows = S.rows();
+                            record.S_cols = S.cols();
+                            record.T_rows = T.rows();
+                            record.T_cols = T.cols();
+                            record.threads = threads;
+                            time_record(record, engine, metric, S, T_run, options, pool);
+                            std::cout << std::left << std::setw(10) << record.engine << std::setw(7)
+                                      << record.method << std::setw(10) << record.placement << std::right
+                                      << std::setw(8) << threads << std::setprecision(6) << std::setw(12)
+                                      << record.stats.min << std::setw(12) << record.stats.median << std::setw(12)
+                                      << record.stats.p95 << std::setw(12) << record.stats.stddev
+                                      << std::setprecision(2) << std::setw(14) << record.windows_per_second / 1e6
+                                      << std::setw(10) << record.gb_per_second << "\n";
+                            records.push_back(std::move(record));
+                        }
+                    }
+                }
+            }
+        }
+
+        write_bench_json(options.json, {num_cores, element_width_name(options.storage), options.warmup,
+                                        options.repetitions},
+                         records);
+        std::cout << "\nWrote " << options.json << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+
+#include "compute.hpp"
+
+struct SchedulerStats;
+
+// A template prepared once for batch matching: its dense values and the sums every
+// window score reuses, so an extra template costs only the ΣX/ΣXY work per window
+struct BatchTemplate
+{
+    std::string name;
+    int rows = 0, cols = 0;
+    std::vector<int> values;
+    long long sum_Y = 0, sum_YY = 0;
+};
+
+BatchTemplate prepare_template(const Matrix &S, const std::string &name = "");
+
+// Best value and tied positions of one template, in the order the templates were given
+struct TemplateResult
+{
+    std::string name;
+    double best_value;
+    std::vector<std::pair<int, int>> best_positions;
+};
+
+// Match every template against T in one tiled traversal: each tile of T is loaded
+// once and scored against all templates that have positions in it. Tiles cover the
+// positions of the smallest template and are sized for the largest one's footprint.
+void compute_batch(const std::vector<BatchTemplate> &templates, const Matrix &T, Metric metric,
+                   std::vector<TemplateResult> &results, int threads_count,
+                   ThreadPool *pool = nullptr, SchedulerStats *stats = nullptr);
+
+#endif
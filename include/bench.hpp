@@ -0,0 +1,47 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <string>
+#include <vector>
+
+#include "matrix.hpp"
+
+// Summary of repeated timings, in seconds
+struct BenchStats
+{
+    double min = 0, median = 0, p95 = 0, mean = 0, stddev = 0;
+};
+
+// p95 is the nearest-rank percentile, stddev the sample standard deviation
+BenchStats summarize_samples(std::vector<double> samples);
+
+// Seeded uniform pixels in [0, 9]
+Matrix synthetic_matrix(int rows, int cols, ElementWidth width, unsigned seed);
+// A rows x cols template cut from T at a seeded position, so a perfect match exists
+Matrix synthetic_template(const Matrix &T, int rows, int cols, unsigned seed);
+
+// One dataset x engine x metric x thread-count measurement
+struct BenchRecord
+{
+    std::string dataset, engine, method;
+    std::string placement = "none"; // worker placement policy, see topology.hpp
+    int S_rows, S_cols, T_rows, T_cols;
+    int threads;
+    std::vector<double> samples;
+    BenchStats stats;
+    double windows_per_second; // match positions per second at the median time
+    double gb_per_second;      // bytes of T per second at the median time
+    double best_value;
+    std::vector<std::pair<int, int>> best_positions;
+};
+
+struct BenchSetup
+{
+    int cores;
+    std::string storage;
+    int warmup, repetitions;
+};
+
+void write_bench_json(const std::string &filename, const BenchSetup &setup, const std::vector<BenchRecord> &records);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef BRANCH_BOUND_HPP
+#define BRANCH_BOUND_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+struct SchedulerStats;
+
+// Work counters of a bounded SSD search, summed over workers
+struct BoundStats
+{
+    long long windows = 0;          // positions visited
+    long long windows_rejected = 0; // abandoned before the last pixel
+    long long pixels_evaluated = 0; // (T, S) pixel pairs actually summed
+    long long pixels_total = 0;     // windows * S_rows * S_cols, the exhaustive cost
+};
+
+// Exact SSD minimum search with branch-and-bound: all workers share the best SSD
+// found so far and abandon a window as soon as its partial sum exceeds it. The
+// template is visited in 16-pixel row segments, those farthest from mean(T) first,
+// so mismatches show up early while the inner loop stays contiguous.
+// Same result and ties as compute(S, T, Metric::SSD, ...).
+void compute_ssd_bounded(const Matrix &S, const Matrix &T,
+                         std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                         ThreadPool *pool = nullptr, BoundStats *bound_stats = nullptr,
+                         SchedulerStats *stats = nullptr);
+
+#endif
@@ -9,28 +9,241 @@
 #include <vector>
 #include <functional>
 #include <utility>
-#include <mutex>
+#include <cmath>
+
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+struct SchedulerStats;
+struct RunTrace;
+
+// Matching metric; the correlations (PCC, NCC) are maximised, the distances (SSD, SAD) minimised.
+// SAD and NCC are only served by the direct engine and the fused pass.
+enum class Metric
+{
+    PCC,
+    SSD,
+    SAD,
+    NCC
+};
+
+inline bool metric_find_max(Metric metric)
+{
+    return metric == Metric::PCC || metric == Metric::NCC;
+}
+
+inline const char *metric_name(Metric metric)
+{
+    switch (metric)
+    {
+    case Metric::PCC:
+        return "PCC";
+    case Metric::SSD:
+        return "SSD";
+    case Metric::SAD:
+        return "SAD";
+    default:
+        return "NCC";
+    }
+}
+
+// Engines built around the PCC/SSD sums reject the other metrics with this
+void require_pcc_or_ssd(Metric metric, const char *engine);
+
+// 以 epsilon 判斷並列，更新最佳值與位置
+inline void update_best(double value, int i, int j, bool find_max,
+                        double &best_value, std::vector<std::pair<int, int>> &best_positions)
+{
+    const double epsilon = 1e-10;
+    if (find_max ? value > best_value + epsilon : value < best_value - epsilon)
+    {
+        best_value = value;
+        best_positions.clear();
+        best_positions.push_back({i, j});
+    }
+    else if (std::abs(value - best_value) < epsilon)
+    {
+        best_positions.push_back({i, j});
+    }
+}
+
+// 合併單一執行緒的局部結果
+inline void merge_best(double local_value, const std::vector<std::pair<int, int>> &local_positions, bool find_max,
+                       double &best_value, std::vector<std::pair<int, int>> &best_positions)
+{
+    const double epsilon = 1e-10;
+    if (find_max ? local_value > best_value + epsilon : local_value < best_value - epsilon)
+    {
+        best_value = local_value;
+        best_positions = local_positions;
+    }
+    else if (std::abs(local_value - best_value) < epsilon)
+    {
+        best_positions.insert(best_positions.end(), local_positions.begin(), local_positions.end());
+    }
+}
+
+// Result modes beyond the single best value + ties
+enum class ResultMode
+{
+    Best,      // best value and its epsilon ties (best_positions)
+    TopK,      // the k best positions
+    Threshold  // the (at most k) best positions scoring at least as well as `threshold`
+};
+
+struct ResultOptions
+{
+    ResultMode mode = ResultMode::Best;
+    int k = 0;              // TopK / Threshold: > 0, bounds every heap so memory is O(k·threads)
+    double threshold = 0.0; // PCC: value >= threshold, SSD/SAD: value <= threshold
+    int nms_radius = 0;     // > 0: drop results within this Chebyshev radius of a better one
+};
+
+struct ScoredPosition
+{
+    double value;
+    int i, j;
+};
+
+// Strict ranking: better score first, then row-major position, so results are deterministic
+inline bool ranks_before(const ScoredPosition &a, const ScoredPosition &b, bool find_max)
+{
+    if (a.value != b.value)
+    {
+        return find_max ? a.value > b.value : a.value < b.value;
+    }
+    return a.i != b.i ? a.i < b.i : a.j < b.j;
+}
+
+// Options the per-worker heaps collect with. NMS runs after the merge, so with a
+// radius R and k > 0 the heaps keep k·(2R+1)² candidates: a kept result suppresses
+// at most (2R+1)² - 1 others, so the k best survivors are always among them.
+// That is the memory bound of NMS: O(k·(2R+1)²·threads) entries of 16 bytes, e.g.
+// k = 100, R = 16 holds up to 108,900 per worker (1.7 MB). Greedy NMS cannot run
+// per worker instead, as a worker's survivor may be suppressed from another tile.
+inline ResultOptions ranked_candidates(const ResultOptions &options)
+{
+    ResultOptions candidates = options;
+    if (options.nms_radius > 0 && options.k > 0)
+    {
+        const long long side = 2LL * options.nms_radius + 1;
+        candidates.k = static_cast<int>(
+            std::min<long long>(options.k * side * side, std::numeric_limits<int>::max()));
+    }
+    return candidates;
+}
+
+// Throws std::invalid_argument when a top-K or threshold search has no bound k > 0
+void validate_result_options(const ResultOptions &options);
+
+// Offer one position to a bounded heap whose front is its worst-ranked entry
+inline void offer_result(const ScoredPosition &candidate, const ResultOptions &options, bool find_max,
+                         std::vector<ScoredPosition> &heap)
+{
+    if (options.mode == ResultMode::Threshold &&
+        (find_max ? candidate.value < options.threshold : candidate.value > options.threshold))
+    {
+        return;
+    }
+    auto cmp = [find_max](const ScoredPosition &a, const ScoredPosition &b)
+    { return ranks_before(a, b, find_max); };
+    if (heap.size() < static_cast<size_t>(options.k))
+    {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+    else if (cmp(candidate, heap.front()))
+    {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+}
+
+// 依核心數與可分配列數限制執行緒數量（有 pool 時不超過 pool 大小）
+size_t resolve_thread_count(int threads_count, int max_i, const ThreadPool *pool = nullptr);
+
+// Split [0, count) into contiguous ranges and run body(thread, begin, end) for each.
+// With a pool, range t goes to worker t; without one, each range gets its own
+// pthread and the calling thread takes range 0.
+void parallel_ranges(int count, int threads_count, const std::function<void(int, int, int)> &body,
+                     ThreadPool *pool = nullptr);
+
+// Per-thread best value and tied positions
+struct LocalBest
+{
+    double value;
+    std::vector<std::pair<int, int>> positions;
+};
+
+// Run band(start_i, end_i, local) over row bands of [0, max_i) on pthreads and
+// merge the local results; `local` arrives reset for find_max
+void parallel_bands(int max_i, int threads_count, bool find_max,
+                    const std::function<void(int, int, LocalBest &)> &band,
+                    std::vector<std::pair<int, int>> &best_positions, double &best_value,
+                    ThreadPool *pool = nullptr);
 
 void compute(const std::vector<int> &S, const std::vector<int> &T,
              int S_rows, int S_cols, int T_rows, int T_cols,
              std::function<double(const std::vector<int> &, const std::vector<int> &)> compute_func,
              bool find_max, std::vector<std::pair<int, int>> &best_positions, double &best_value);
+// Specialised-kernel overload: metric resolved at compile time, T read in place
+void compute(const Matrix &S, const Matrix &T, Metric metric,
+             std::vector<std::pair<int, int>> &best_positions, double &best_value);
+
+struct ComputeThreadData;
+// Scans one tile of a ComputeThreadData, filling its local best (or local_results)
+using ScanKernel = void (*)(ComputeThreadData *);
 
 struct ComputeThreadData
 {
     const std::vector<int> *S;
     const std::vector<int> *T;
+    const Matrix *T_matrix = nullptr; // read by the specialised kernels
     int S_rows, S_cols, T_rows, T_cols;
     std::function<double(const std::vector<int> &, const std::vector<int> &)> compute_func;
+    ScanKernel kernel = nullptr; // takes precedence over compute_func when set
     bool find_max;
     int start_i, end_i;
+    int start_j, end_j; // column range, used by the specialised kernels
     double local_best_value;
     std::vector<std::pair<int, int>> local_best_positions;
+    const ResultOptions *result_options = nullptr; // set for the top-K / threshold kernels
+    std::vector<ScoredPosition> local_results;     // bounded heap, worst entry at the front
 };
 
+// Inputs for the specialised kernels over every column of T, with the local best
+// reset; S_values (S expanded to dense ints) and T must outlive the result
+ComputeThreadData kernel_thread_data(const Matrix &T, const std::vector<int> &S_values,
+                                     int S_rows, int S_cols, Metric metric);
+
 void compute_parallel(const std::vector<int> &S, const std::vector<int> &T,
                       int S_rows, int S_cols, int T_rows, int T_cols,
                       std::function<double(const std::vector<int> &, const std::vector<int> &)> compute_func,
-                      bool find_max, std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count);
+                      bool find_max, std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool = nullptr);
+// Scheduled as cache-sized 2D tiles with work stealing; stats receives per-worker
+// tile and steal counts, trace per-worker timings and the merge time
+void compute_parallel(const Matrix &S, const Matrix &T, Metric metric,
+                      std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool = nullptr, SchedulerStats *stats = nullptr, RunTrace *trace = nullptr);
+
+// Top-K / threshold search with the compute_parallel scheduler. Each worker keeps a
+// bounded heap; the heaps are sorted and merged pairwise in parallel, then NMS is
+// applied. Results come back best first. Memory is O(k · threads), k > 0 (see
+// ranked_candidates for NMS).
+void compute_ranked(const Matrix &S, const Matrix &T, Metric metric, const ResultOptions &options,
+                    std::vector<ScoredPosition> &results, int threads_count, ThreadPool *pool = nullptr);
+
+// Sort per-worker bounded heaps (filled with ranked_candidates(options)) and merge
+// them pairwise in parallel, best first, then apply NMS and truncate to options.k;
+// lists is consumed
+void merge_ranked(std::vector<std::vector<ScoredPosition>> &lists, const ResultOptions &options, bool find_max,
+                  std::vector<ScoredPosition> &results, int threads_count, ThreadPool *pool = nullptr);
+
+// Greedy non-maximum suppression over best-first results
+void suppress_non_maxima(std::vector<ScoredPosition> &results, int radius);
+
+void validate_dimensions(const Matrix &S, const Matrix &T);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <string>
+#include <vector>
+
+#include "compute.hpp"
+
+// Search engines selectable from the command line
+enum class Engine
+{
+    Direct,
+    Integral,
+    FFT,
+    SIMD,
+    BranchBound,
+    Exact,
+    Pyramid,
+    Stream
+};
+
+// "direct", "integral", "fft", "simd", "bnb", "exact", "pyramid" or "stream"; throws std::runtime_error
+Engine parse_engine(const std::string &name);
+std::string engine_name(Engine engine);
+// The command-line name parse_engine accepts: "simd" rather than "simd (AVX2)"
+const char *engine_option(Engine engine);
+// "pcc,ssd,sad" -> {PCC, SSD, SAD}, case-insensitive, duplicates dropped
+std::vector<Metric> parse_metrics(const std::string &list);
+
+// Best value and ties of one run of an in-memory engine. Exact and bnb fall back to
+// the direct search for metrics (or inputs) they do not serve; the stream engine
+// reads T from disk and is rejected with std::invalid_argument.
+void run_engine(Engine engine, Metric metric, const Matrix &S, const Matrix &T,
+                std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                ThreadPool *pool = nullptr);
+
+#endif
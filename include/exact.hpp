@@ -0,0 +1,22 @@
+#ifndef EXACT_HPP
+#define EXACT_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+// Work counters of an exact-match scan
+struct ExactStats
+{
+    long long hash_hits = 0; // windows whose hash equalled the template's
+    long long matches = 0;   // hits that survived pixel verification
+};
+
+// Positions where S occurs verbatim in T, in row-major order (the SSD == 0 set).
+// A 2D Rabin-Karp hash is rolled down the columns and along each row in O(1) per
+// position, over row bands in parallel; only hash hits are compared against S.
+// `positions` is empty when S does not occur.
+void compute_exact(const Matrix &S, const Matrix &T, std::vector<std::pair<int, int>> &positions,
+                   int threads_count, ThreadPool *pool = nullptr, ExactStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+#include "compute.hpp"
+
+// Iterative radix-2 FFT plan for a fixed power-of-two length
+struct FFTPlan
+{
+    int n = 0;
+    std::vector<int> bit_reverse;
+    std::vector<std::complex<double>> twiddle; // e^{-2πik/n}, k < n/2
+
+    explicit FFTPlan(int size);
+    void transform(std::complex<double> *data, bool inverse) const;
+};
+
+// In-place 2D FFT of a rows x cols row-major buffer (both powers of two);
+// the inverse transform is scaled by 1 / (rows * cols)
+void fft_2d(std::vector<std::complex<double>> &data, const FFTPlan &row_plan, const FFTPlan &col_plan,
+            bool inverse);
+
+int next_pow2(int n);
+
+// FFT engine: cross term from overlap-save tiled correlation, window sums from
+// summed-area tables of each tile. T is read in place, so memory is a few tile
+// buffers per thread. Tiles are pulled by the worker threads.
+void compute_fft(const Matrix &S, const Matrix &T, Metric metric,
+                 std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                 ThreadPool *pool = nullptr);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FUSED_HPP
+#define FUSED_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+struct SchedulerStats;
+
+// Best value and tied positions for one metric of a fused pass
+struct MetricResult
+{
+    Metric metric;
+    double best_value;
+    std::vector<std::pair<int, int>> best_positions;
+};
+
+// One entry per requested metric, in request order
+struct MultiMetricResult
+{
+    std::vector<MetricResult> results;
+
+    // Throws std::out_of_range when the metric was not requested
+    const MetricResult &operator[](Metric metric) const;
+};
+
+// Evaluate every metric in `metrics` during a single traversal of T: each window is
+// gathered once into ΣX, ΣX², ΣXY (and Σ|X-Y| when SAD is requested), and every
+// metric keeps its own best/ties tracker. Scheduled like compute_parallel.
+void compute_fused(const Matrix &S, const Matrix &T, const std::vector<Metric> &metrics,
+                   MultiMetricResult &result, int threads_count,
+                   ThreadPool *pool = nullptr, SchedulerStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+// Changed region of T: rows [r0, r1) x columns [c0, c1)
+struct DirtyRect
+{
+    int r0, r1, c0, c1;
+};
+
+// Dirty rectangles between two frames of the same shape: one per row that differs,
+// spanning its first to last changed column
+std::vector<DirtyRect> diff_frames(const Matrix &before, const Matrix &after);
+
+// Work done by the last IncrementalMatch::update
+struct IncrementalStats
+{
+    long long rescored = 0; // window positions scored again
+    int blocks = 0;         // block summaries rebuilt, of blocks_total
+    int blocks_total = 0;
+};
+
+// Match state kept across frames of T that change only in small rectangles. Every
+// window score is retained in a score map, summarised per 64x64 block of positions
+// by its best value and ties. An update rescores only the windows overlapping the
+// dirty rectangles, rebuilds the summaries of the blocks they fall in and reduces
+// the block summaries to the global best, so a best position that got worse is
+// replaced without rescanning T. Scores and epsilon ties are those of compute();
+// ties are listed in row-major order. Memory: 8 bytes per window position.
+class IncrementalMatch
+{
+public:
+    IncrementalMatch(const Matrix &S, Metric metric);
+
+    // Score every window of T (the first frame, or after a change of shape)
+    void reset(const Matrix &T, int threads_count, ThreadPool *pool = nullptr);
+    // T differs from the previous frame only inside `dirty`; its shape must not change
+    void update(const Matrix &T, const std::vector<DirtyRect> &dirty, int threads_count,
+                ThreadPool *pool = nullptr, IncrementalStats *stats = nullptr);
+
+    double best_value() const { return best_value_; }
+    const std::vector<std::pair<int, int>> &best_positions() const { return best_positions_; }
+    // Retained score of the window at (i, j)
+    double score(int i, int j) const { return scores_[static_cast<size_t>(i) * max_j_ + j]; }
+
+    static constexpr int block_size = 64;
+
+private:
+    struct Span
+    {
+        int i, j0, j1; // window positions (i, j0) .. (i, j1 - 1)
+    };
+
+    void rescore(const Matrix &T, const std::vector<Span> &spans, int threads_count, ThreadPool *pool);
+    void summarise(const std::vector<int> &blocks, int threads_count, ThreadPool *pool);
+    void reduce();
+
+    Metric metric_;
+    bool find_max_;
+    int S_rows_, S_cols_;
+    std::vector<int> S_values_;
+
+    int T_rows_ = 0, T_cols_ = 0, max_i_ = 0, max_j_ = 0;
+    int blocks_i_ = 0, blocks_j_ = 0;
+    std::vector<double> scores_;
+    std::vector<LocalBest> summaries_; // per block, row-major
+    double best_value_ = 0.0;
+    std::vector<std::pair<int, int>> best_positions_;
+};
+
+#endif
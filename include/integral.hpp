@@ -0,0 +1,44 @@
+#ifndef INTEGRAL_HPP
+#define INTEGRAL_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "compute.hpp"
+
+// Summed-area tables of T and T², (rows + 1) x (cols + 1) with a zero border.
+// Entries are uint32_t and may wrap: every window sum is far below 2^32, so the
+// four-corner difference in modular arithmetic is still exact.
+struct IntegralImage
+{
+    int rows = 0, cols = 0;
+    std::vector<uint32_t> sum;
+    std::vector<uint32_t> sum_sq;
+
+    uint32_t window_sum(int i, int j, int h, int w) const
+    {
+        return corner_diff(sum, i, j, h, w);
+    }
+    uint32_t window_sum_sq(int i, int j, int h, int w) const
+    {
+        return corner_diff(sum_sq, i, j, h, w);
+    }
+
+private:
+    uint32_t corner_diff(const std::vector<uint32_t> &table, int i, int j, int h, int w) const
+    {
+        size_t stride = cols + 1;
+        return table[(i + h) * stride + (j + w)] - table[i * stride + (j + w)] -
+               table[(i + h) * stride + j] + table[i * stride + j];
+    }
+};
+
+void build_integral_image(const Matrix &T, IntegralImage &image, int threads_count, ThreadPool *pool = nullptr);
+
+// Summed-area-table engine: O(1) window sums, only the S·T cross term per position
+void compute_integral(const Matrix &S, const Matrix &T, Metric metric,
+                      std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool = nullptr);
+
+#endif
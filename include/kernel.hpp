@@ -0,0 +1,347 @@
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include <cmath>
+#include <type_traits>
+
+#include "compute.hpp"
+#include "pcc.hpp"
+#include "ssd.hpp"
+
+// Window metrics as functors: an accumulator fed (T, S) pixel pairs read in place
+struct PCCKernel
+{
+    struct Accumulator
+    {
+        int sum_X = 0, sum_Y = 0, sum_XX = 0, sum_YY = 0, sum_XY = 0;
+        void add(int x, int y)
+        {
+            sum_X += x;
+            sum_Y += y;
+            sum_XX += x * x;
+            sum_YY += y * y;
+            sum_XY += x * y;
+        }
+        double result(int n) const
+        {
+            return pcc_from_sums(n, sum_X, sum_Y, sum_XX, sum_YY, sum_XY);
+        }
+    };
+    static constexpr bool find_max = true;
+};
+
+struct SSDKernel
+{
+    struct Accumulator
+    {
+        int ssd = 0;
+        void add(int x, int y)
+        {
+            int diff = x - y;
+            ssd += diff * diff;
+        }
+        double result(int) const
+        {
+            return ssd;
+        }
+    };
+    static constexpr bool find_max = false;
+};
+
+struct SADKernel
+{
+    struct Accumulator
+    {
+        int sad = 0;
+        void add(int x, int y)
+        {
+            sad += x > y ? x - y : y - x;
+        }
+        double result(int) const
+        {
+            return sad;
+        }
+    };
+    static constexpr bool find_max = false;
+};
+
+struct NCCKernel
+{
+    struct Accumulator
+    {
+        int sum_XX = 0, sum_YY = 0, sum_XY = 0;
+        void add(int x, int y)
+        {
+            sum_XX += x * x;
+            sum_YY += y * y;
+            sum_XY += x * y;
+        }
+        double result(int) const
+        {
+            return ncc_from_sums(sum_XX, sum_YY, sum_XY);
+        }
+    };
+    static constexpr bool find_max = true;
+};
+
+// Template halves of the PCC and NCC denominators, cached once per template (Matcher)
+struct TemplateCache
+{
+    double sqrt_var_Y = 0.0;  // sqrt(nΣY² - (ΣY)²)
+    double sqrt_sum_YY = 0.0; // sqrt(ΣY²)
+};
+
+// PCC fed (x, c) pairs against the centred template c = n·y - ΣY: Σx·c is already the
+// numerator nΣXY - ΣXΣY, so a window only accumulates ΣX, ΣX² and Σx·c
+struct CenteredPCCKernel
+{
+    struct Accumulator
+    {
+        int sum_X = 0, sum_XX = 0;
+        long long sum_XC = 0;
+        void add(int x, int c)
+        {
+            sum_X += x;
+            sum_XX += x * x;
+            sum_XC += static_cast<long long>(x) * c;
+        }
+        long long var_X(long long n) const
+        {
+            return n * sum_XX - static_cast<long long>(sum_X) * sum_X;
+        }
+        double result(int n, const TemplateCache &cache) const
+        {
+            long long var = var_X(n);
+            return var == 0 || cache.sqrt_var_Y == 0.0
+                       ? 0.0
+                       : static_cast<double>(sum_XC) / (std::sqrt(static_cast<double>(var)) * cache.sqrt_var_Y);
+        }
+    };
+    static constexpr bool find_max = true;
+};
+
+// NCC with ΣY² cached: a window only accumulates ΣX² and ΣXY
+struct CachedNCCKernel
+{
+    struct Accumulator
+    {
+        int sum_XX = 0, sum_XY = 0;
+        void add(int x, int y)
+        {
+            sum_XX += x * x;
+            sum_XY += x * y;
+        }
+        double result(int, const TemplateCache &cache) const
+        {
+            return sum_XX == 0 || cache.sqrt_sum_YY == 0.0
+                       ? 0.0
+                       : sum_XY / (std::sqrt(static_cast<double>(sum_XX)) * cache.sqrt_sum_YY);
+        }
+    };
+    static constexpr bool find_max = true;
+};
+
+// Score of an accumulator; the cached kernels take their template half from `cache`
+template <class Accumulator>
+inline double cached_result(const Accumulator &acc, int n, const TemplateCache &)
+{
+    return acc.result(n);
+}
+inline double cached_result(const CenteredPCCKernel::Accumulator &acc, int n, const TemplateCache &cache)
+{
+    return acc.result(n, cache);
+}
+inline double cached_result(const CachedNCCKernel::Accumulator &acc, int n, const TemplateCache &cache)
+{
+    return acc.result(n, cache);
+}
+
+// Raw window sums for callers that score several metrics from one gather (fused) or
+// bring their own template sums (batch): ΣX, ΣX², ΣXY when Moments, Σ|X-Y| when AbsDiff
+template <bool Moments, bool AbsDiff>
+struct WindowSums
+{
+    int sum_X = 0, sum_XX = 0, sum_XY = 0, sum_AD = 0;
+    void add(int x, int y)
+    {
+        if (Moments)
+        {
+            sum_X += x;
+            sum_XX += x * x;
+            sum_XY += x * y;
+        }
+        if (AbsDiff)
+        {
+            sum_AD += x > y ? x - y : y - x;
+        }
+    }
+    // Same value as the metric's own kernel, given the template's ΣY and ΣY²
+    double score(Metric metric, int n, long long sum_Y, long long sum_YY) const
+    {
+        switch (metric)
+        {
+        case Metric::PCC:
+            return pcc_from_sums(n, sum_X, sum_Y, sum_XX, sum_YY, sum_XY);
+        case Metric::SSD:
+            return ssd_from_sums(sum_XX, sum_YY, sum_XY);
+        case Metric::SAD:
+            return sum_AD;
+        default:
+            return ncc_from_sums(sum_XX, sum_YY, sum_XY);
+        }
+    }
+};
+
+// Feed one window of T (top-left at `window`, row stride `stride` pixels) and the
+// dense S into `acc`. R/C > 0 fix the template shape at compile time; 0 means runtime
+// rows/cols. Every window kernel in the tree gathers through this loop.
+template <int R, int C, class Accumulator, class Pixel>
+inline void accumulate_window(Accumulator &acc, const Pixel *window, size_t stride, const int *S, int rows, int cols)
+{
+    const int n_rows = R > 0 ? R : rows;
+    const int n_cols = C > 0 ? C : cols;
+    for (int k = 0; k < n_rows; ++k)
+    {
+        const Pixel *t_row = window + k * stride;
+        const int *s_row = S + k * n_cols;
+        for (int l = 0; l < n_cols; ++l)
+        {
+            acc.add(t_row[l], s_row[l]);
+        }
+    }
+}
+
+// Score of one window under MetricKernel
+template <class MetricKernel, int R, int C, class Pixel>
+inline double window_score(const Pixel *window, size_t stride, const int *S, int rows, int cols)
+{
+    typename MetricKernel::Accumulator acc;
+    accumulate_window<R, C>(acc, window, stride, S, rows, cols);
+    return acc.result((R > 0 ? R : rows) * (C > 0 ? C : cols));
+}
+
+// Gather every window of positions [i0, i1) x [j0, j1) into a fresh Accumulator and
+// hand it to visit(acc, i, j); `window` points at pixel (i0, j0)
+template <class Accumulator, int R, int C, class Pixel, class Visit>
+inline void scan_tile(const Pixel *window, size_t stride, const int *S, int rows, int cols, int i0, int i1, int j0,
+                      int j1, Visit &&visit)
+{
+    for (int i = i0; i < i1; ++i)
+    {
+        const Pixel *t_row = window + (i - i0) * stride;
+        for (int j = j0; j < j1; ++j)
+        {
+            Accumulator acc;
+            accumulate_window<R, C>(acc, t_row + (j - j0), stride, S, rows, cols);
+            visit(acc, i, j);
+        }
+    }
+}
+
+// Call pick(R, C) with the 3x3 / 5x5 specialisation when it applies, else with the
+// runtime shape <0, 0>; R and C arrive as std::integral_constant
+template <class Pick>
+inline auto dispatch_shape(int S_rows, int S_cols, Pick &&pick)
+{
+    if (S_rows == 3 && S_cols == 3)
+    {
+        return pick(std::integral_constant<int, 3>(), std::integral_constant<int, 3>());
+    }
+    if (S_rows == 5 && S_cols == 5)
+    {
+        return pick(std::integral_constant<int, 5>(), std::integral_constant<int, 5>());
+    }
+    return pick(std::integral_constant<int, 0>(), std::integral_constant<int, 0>());
+}
+
+// Packed 4-bit T for the tile kernels: rows x cols pixels from (i0, j0), one byte each
+inline void unpack_tile(const Matrix &T, int i0, int j0, int rows, int cols, std::vector<uint8_t> &buffer)
+{
+    buffer.resize(static_cast<size_t>(rows) * cols);
+    for (int r = 0; r < rows; ++r)
+    {
+        T.unpack_row(i0 + r, j0, cols, buffer.data() + static_cast<size_t>(r) * cols);
+    }
+}
+
+// Record one score: local best + ties, or the ranked heap when Collect is set
+template <bool Collect>
+inline void record_score(ComputeThreadData *data, double value, int i, int j, bool find_max)
+{
+    if (Collect)
+    {
+        offer_result({value, i, j}, *data->result_options, find_max, data->local_results);
+    }
+    else
+    {
+        update_best(value, i, j, find_max, data->local_best_value, data->local_best_positions);
+    }
+}
+
+// Scan positions [start_i, end_i) x [start_j, end_j) reading T_matrix in place.
+// Results accumulate into the local best, so one ComputeThreadData can take many tiles.
+template <class MetricKernel, int R, int C, class Pixel, bool Collect>
+void scan_band(ComputeThreadData *data)
+{
+    const bool find_max = MetricKernel::find_max;
+    const Matrix &T = *data->T_matrix;
+    if (data->start_i >= data->end_i)
+    {
+        return;
+    }
+    const int n = data->S_rows * data->S_cols;
+    scan_tile<typename MetricKernel::Accumulator, R, C>(
+        T.row<Pixel>(data->start_i) + data->start_j, T.stride() / sizeof(Pixel), data->S->data(), data->S_rows,
+        data->S_cols, data->start_i, data->end_i, data->start_j, data->end_j,
+        [&](const typename MetricKernel::Accumulator &acc, int i, int j)
+        {
+            record_score<Collect>(data, acc.result(n), i, j, find_max);
+        });
+}
+
+// Packed 4-bit T: the columns a band touches are unpacked once per row into a
+// window of S_rows byte rows. Row r lands in slots r % S_rows and r % S_rows + S_rows,
+// so the rows of every window are contiguous from slot i % S_rows.
+template <class MetricKernel, int R, int C, bool Collect>
+void scan_band_nibble(ComputeThreadData *data)
+{
+    const bool find_max = MetricKernel::find_max;
+    if (data->start_i >= data->end_i || data->start_j >= data->end_j)
+    {
+        return;
+    }
+
+    const int *S = data->S->data();
+    const Matrix &T = *data->T_matrix;
+    const int S_rows = data->S_rows;
+    const int c0 = data->start_j;
+    const size_t stride = data->end_j - data->start_j + data->S_cols - 1;
+    std::vector<uint8_t> rows(2 * S_rows * stride);
+    auto load = [&](int r)
+    {
+        uint8_t *slot = rows.data() + (r % S_rows) * stride;
+        T.unpack_row(r, c0, stride, slot);
+        std::copy(slot, slot + stride, slot + S_rows * stride);
+    };
+    for (int r = data->start_i; r < data->start_i + S_rows - 1; ++r)
+    {
+        load(r);
+    }
+
+    for (int i = data->start_i; i < data->end_i; ++i)
+    {
+        load(i + S_rows - 1);
+        const uint8_t *t_row = rows.data() + (i % S_rows) * stride - c0;
+        for (int j = data->start_j; j < data->end_j; ++j)
+        {
+            double value = window_score<MetricKernel, R, C>(t_row + j, stride, S, S_rows, data->S_cols);
+            record_score<Collect>(data, value, i, j, find_max);
+        }
+    }
+}
+
+// Pick the 3x3 / 5x5 specialisation when it applies, else the runtime-size kernel,
+// instantiated for the storage width of T; `collect` picks the ranked-heap variant
+ScanKernel select_kernel(Metric metric, int S_rows, int S_cols, ElementWidth width, bool collect = false);
+
+#endif
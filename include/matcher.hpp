@@ -0,0 +1,61 @@
+#ifndef MATCHER_HPP
+#define MATCHER_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+struct SchedulerStats;
+struct RunTrace;
+
+struct MatchOptions
+{
+    ResultOptions results;            // best value + ties unless top-K / threshold is asked for; NMS applies to those
+    int threads = 0;                  // <= 0: every core
+    ThreadPool *pool = nullptr;
+    SchedulerStats *stats = nullptr;  // per-worker tile and steal counts
+    RunTrace *trace = nullptr;        // per-worker timings, counters and the merge time
+    int tile_rows = 0, tile_cols = 0; // output tile shape, 0 = sized from L2 by make_tiles
+};
+
+struct MatchResult
+{
+    double best_value = 0.0;
+    std::vector<std::pair<int, int>> best_positions; // ties of the best value, or every ranked position
+    std::vector<ScoredPosition> ranked;              // top-K / threshold modes only, best first
+};
+
+// A template S prepared once for one metric. The constructor caches what every
+// window score would otherwise recompute: the template sums, its centred values
+// and its norm. match() only reads the Matcher, so one object can serve any number
+// of T inputs, from several threads at once.
+class Matcher
+{
+public:
+    Matcher(const Matrix &S, Metric metric);
+
+    Metric metric() const { return metric_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    double mean() const;
+    // sqrt(Σ(y - mean)²)
+    double norm() const;
+    // n·y - ΣY for every template pixel: the centred template scaled by n, exact in
+    // integers, so Σx·c is the PCC numerator nΣXY - ΣXΣY
+    const std::vector<int> &centered() const { return centered_; }
+
+    // Tiled, work-stealing search of T (see compute_parallel); scores match compute().
+    // Best-mode PCC compares windows exactly in integers (compare_pcc_exact) rather
+    // than within an epsilon, so the tie set is the same for every thread count.
+    MatchResult match(const Matrix &T, const MatchOptions &options = MatchOptions()) const;
+
+private:
+    Metric metric_;
+    int rows_, cols_;
+    std::vector<int> values_, centered_;
+    long long sum_Y_ = 0, sum_YY_ = 0;
+    double sqrt_var_Y_ = 0.0;  // sqrt(nΣY² - (ΣY)²), the PCC denominator's template half
+    double sqrt_sum_YY_ = 0.0; // NCC denominator's template half
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MATFILE_HPP
+#define MATFILE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "matrix.hpp"
+
+// Read-only mapping of a whole file, unmapped on destruction
+struct MappedFile
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+// Binary matrix container: a 64-byte header followed by rows * stride bytes of
+// pixel data in Matrix layout and a zeroed 64-byte tail, so the mapping can be
+// used as a Matrix without copying.
+struct MatrixFileHeader
+{
+    char magic[8];         // "EMCSSMAT"
+    uint32_t version;      // matrix_file_version
+    uint32_t element_width; // ElementWidth
+    int32_t rows, cols;
+    uint64_t stride;     // bytes per row
+    uint64_t data_bytes; // rows * stride
+    uint64_t checksum;   // matrix_checksum of the pixel data
+    uint8_t reserved[16];
+};
+static_assert(sizeof(MatrixFileHeader) == Matrix::alignment, "header must keep pixel data aligned");
+
+constexpr uint32_t matrix_file_version = 1;
+
+uint64_t matrix_checksum(const uint8_t *data, size_t size);
+
+// "dir/T1_300_400.txt" -> "dir/T1_300_400.bin"
+std::string binary_path_for(const std::string &text_file);
+// True when the .bin next to text_file exists and is not older than it
+bool binary_is_fresh(const std::string &text_file);
+
+// Check magic, version and layout against the file size; throws std::runtime_error
+void validate_matrix_header(const MatrixFileHeader &header, size_t file_size, const std::string &filename);
+
+void write_binary_matrix(const std::string &filename, const Matrix &matrix);
+// Map a binary matrix in place; the returned Matrix keeps the mapping alive
+Matrix map_binary_matrix(const std::string &filename, int expected_rows, int expected_cols, bool verify = true);
+// Parse a text matrix and write its binary cache next to it
+void convert_to_binary(const std::string &text_file, int rows, int cols, ElementWidth width, int threads_count);
+
+#endif
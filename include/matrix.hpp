@@ -0,0 +1,92 @@
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Storage width of one pixel; pixels are 0-9 so every width is lossless
+enum class ElementWidth
+{
+    Int32,
+    UInt8,
+    Nibble // two pixels per byte, even column in the low nibble
+};
+
+const char *element_width_name(ElementWidth width);
+ElementWidth parse_element_width(const std::string &name);
+
+// Row-major pixel matrix with selectable element width. Rows start on 64-byte
+// (cache line) boundaries and the buffer carries a 64-byte zeroed tail, so
+// unaligned SIMD loads that run past the last column stay in bounds.
+// Copies are shallow and share the pixel buffer, like a view.
+class Matrix
+{
+public:
+    static constexpr size_t alignment = 64;
+
+    Matrix() = default;
+    Matrix(int rows, int cols, ElementWidth width);
+    // Wrap an existing buffer laid out like a Matrix; `owner` keeps it alive
+    Matrix(int rows, int cols, ElementWidth width, size_t stride, const uint8_t *data,
+           std::shared_ptr<const void> owner);
+
+    // Rows left unwritten (only the tail is zeroed), so each page is first touched,
+    // and placed on a NUMA node, by whichever thread fills it
+    static Matrix uninitialized(int rows, int cols, ElementWidth width);
+    static Matrix from_vector(const std::vector<int> &values, int rows, int cols, ElementWidth width);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    ElementWidth width() const { return width_; }
+    size_t stride() const { return stride_; } // bytes per row
+    size_t bytes() const { return stride_ * rows_; }
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+
+    const uint8_t *row_bytes(int r) const { return data_ + r * stride_; }
+    uint8_t *row_bytes(int r) { return mutable_data_ + r * stride_; }
+    template <class Pixel>
+    const Pixel *row(int r) const
+    {
+        return reinterpret_cast<const Pixel *>(row_bytes(r));
+    }
+
+    int at(int r, int c) const
+    {
+        const uint8_t *p = row_bytes(r);
+        switch (width_)
+        {
+        case ElementWidth::Int32:
+            return reinterpret_cast<const int32_t *>(p)[c];
+        case ElementWidth::UInt8:
+            return p[c];
+        default:
+            return (c & 1) ? p[c >> 1] >> 4 : p[c >> 1] & 0x0f;
+        }
+    }
+    void set(int r, int c, int value);
+
+    // Expand row r, columns [c0, c0 + count), to one byte per pixel
+    void unpack_row(int r, int c0, int count, uint8_t *out) const;
+    // Store a full row given as one byte per pixel
+    void pack_row(int r, const uint8_t *values);
+    std::vector<int> to_vector() const;
+    // Same pixels at another width; shares the buffer when the width already matches
+    Matrix as_width(ElementWidth width) const;
+    // Deep copy into a fresh writable buffer (for wrapped or shared read-only pixels)
+    Matrix clone() const;
+
+    static size_t row_stride(int cols, ElementWidth width);
+
+private:
+    int rows_ = 0, cols_ = 0;
+    ElementWidth width_ = ElementWidth::UInt8;
+    size_t stride_ = 0;
+    const uint8_t *data_ = nullptr;
+    uint8_t *mutable_data_ = nullptr; // null for wrapped read-only buffers
+    std::shared_ptr<const void> owner_;
+};
+
+#endif
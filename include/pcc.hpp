@@ -5,5 +5,30 @@
 
 double compute_pcc(const std::vector<int> &X, const std::vector<int> &Y);
 double compute_pcc_parallel(const std::vector<int> &X, const std::vector<int> &Y);
+double pcc_from_sums(long long n, long long sum_X, long long sum_Y,
+                     long long sum_XX, long long sum_YY, long long sum_XY);
+// Exact order of two PCC values num_a / sqrt(var_a) and num_b / sqrt(var_b) sharing
+// one template variance, with var_a, var_b > 0: -1, 0 or 1 as a is worse, tied or
+// better. Compares num² · var by cross-multiplying in 128 bits, so there is no
+// sqrt and no epsilon; exact while 81³ · n⁶ < 2¹²⁷ (n pixels per window).
+inline int compare_pcc_exact(long long num_a, long long var_a, long long num_b, long long var_b)
+{
+    int sign_a = (num_a > 0) - (num_a < 0), sign_b = (num_b > 0) - (num_b < 0);
+    if (sign_a != sign_b)
+    {
+        return sign_a < sign_b ? -1 : 1;
+    }
+    __int128 lhs = static_cast<__int128>(num_a) * num_a * var_b;
+    __int128 rhs = static_cast<__int128>(num_b) * num_b * var_a;
+    if (lhs == rhs)
+    {
+        return 0;
+    }
+    // Larger squares rank higher for positive correlations and lower for negative ones
+    return (lhs > rhs) == (sign_a > 0) ? 1 : -1;
+}
+
+// Uncentred normalised cross-correlation ΣXY / sqrt(ΣX²ΣY²)
+double ncc_from_sums(long long sum_XX, long long sum_YY, long long sum_XY);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "compute.hpp"
+#include "utils.hpp"
+
+// Row-readiness watermark over the chunks of a text parse: each chunk publishes how
+// many of its rows are in the matrix, and readers block until a row range is.
+class RowWatermark
+{
+public:
+    explicit RowWatermark(const std::vector<ParseChunk> &chunks);
+
+    void publish(int chunk, int rows_parsed);
+    // Wake every waiter for good after a parse error
+    void fail();
+    // Block until rows [begin, end) are parsed; false if the parse failed
+    bool wait_rows(int begin, int end);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<int> first_, lines_, ready_;
+    bool failed_ = false;
+};
+
+struct PipelineStats
+{
+    double parse_seconds = 0; // until the last chunk was parsed
+    double total_seconds = 0; // until the last position was scored
+    double wait_seconds = 0;  // summed time workers blocked on the watermark
+};
+
+// Parse the text matrix T_file into T while matching S against it. Each worker
+// parses its chunk of rows and scores output row i as soon as rows i..i+S_rows-1
+// are in, so parsing and scoring overlap; the last S_rows - 1 rows of a chunk wait
+// on the next chunk's watermark, so each chunk runs on its own pool worker (a private
+// pool is made when none is given) and the pool must not be running another batch.
+// A .bin T_file is simply mapped first.
+void compute_pipelined(const Matrix &S, const std::string &T_file, int T_rows, int T_cols, Metric metric,
+                       ElementWidth width, Matrix &T,
+                       std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                       ThreadPool *pool = nullptr, PipelineStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PLANNER_HPP
+#define PLANNER_HPP
+
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+
+// One configuration of a search: engine, worker count and (direct engine only)
+// output tile shape, with the time the cost model expects for it
+struct Plan
+{
+    Engine engine = Engine::Direct;
+    int threads = 1;
+    int tile_rows = 0, tile_cols = 0; // 0 = make_tiles default
+    double predicted_seconds = 0.0;
+    bool cached = false;  // read from the tuning file rather than probed
+};
+
+struct PlannerOptions
+{
+    std::string tuning_file = "tuning.cache"; // "" = neither read nor write a cache
+    bool retune = false;                      // probe even if the shape is cached
+    int repetitions = 3;                      // timed runs per probe, the fastest counts
+    bool verbose = false;                     // print every probe and prediction
+};
+
+// "PCC 16x16 1000x1000 uint8 8": metric, S and T shape, storage and core count
+std::string plan_key(Metric metric, const Matrix &S, const Matrix &T, int cores);
+
+// Pick engine, thread count and tile shape for matching S in T. A plan for the same
+// key in options.tuning_file is reused; otherwise a short probe calibrates the cost
+// model on this machine (a second or two) and the result is added to the file.
+// Only engines whose results equal compute() are considered.
+Plan plan_match(const Matrix &S, const Matrix &T, Metric metric, ThreadPool &pool,
+                const PlannerOptions &options = PlannerOptions());
+
+// "direct, 4 threads, 32x512 tiles"
+std::string describe_plan(const Plan &plan);
+
+// One search with the planned configuration
+void run_plan(const Plan &plan, Metric metric, const Matrix &S, const Matrix &T,
+              std::vector<std::pair<int, int>> &best_positions, double &best_value, ThreadPool *pool);
+
+#endif
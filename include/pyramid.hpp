@@ -0,0 +1,33 @@
+#ifndef PYRAMID_HPP
+#define PYRAMID_HPP
+
+#include <vector>
+
+#include "compute.hpp"
+
+// Candidates entering and surviving one pyramid level
+struct PyramidLevel
+{
+    int block;            // block edge in pixels
+    long long candidates; // positions bounded at this level
+    long long survivors;  // positions whose bound could still reach the incumbent
+};
+
+struct PyramidStats
+{
+    std::vector<PyramidLevel> levels; // coarsest first
+    long long positions = 0;          // max_i * max_j
+    long long full_scored = 0;        // positions scored at full resolution
+};
+
+// Exact coarse-to-fine search. Window and template are cut into b x b blocks whose
+// sums come from a summed-area table; by Cauchy-Schwarz the block sums give a lower
+// bound on SSD and, on the normalised vectors, an upper bound on PCC. Levels run
+// from the coarsest block down to 4x4, each dropping positions whose bound cannot
+// reach the best full score seen so far; only the survivors are scored in full.
+// Result equals compute(S, T, metric, ...).
+void compute_pyramid(const Matrix &S, const Matrix &T, Metric metric,
+                     std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                     ThreadPool *pool = nullptr, PyramidStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <functional>
+#include <vector>
+
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+struct RunTrace;
+
+// Output rectangle [i0, i1) x [j0, j1) of match positions
+struct Tile
+{
+    int i0, i1, j0, j1;
+};
+
+// Per-worker counters from the last run_tiles call, for tuning tile sizes
+struct SchedulerStats
+{
+    std::vector<int> tiles_run;
+    std::vector<int> steals;
+};
+
+// Cut the max_i x max_j output space into row-major tiles whose T footprint
+// ((rows + S_rows - 1) x (cols + S_cols - 1) pixels) fits in half of L2, shrunk
+// further until every worker has a few tiles to balance with. A positive
+// tile_rows / tile_cols fixes that side instead (clamped to the output space).
+std::vector<Tile> make_tiles(int max_i, int max_j, int S_rows, int S_cols, ElementWidth width, int num_workers,
+                             int tile_rows = 0, int tile_cols = 0);
+
+// Run body(worker, tile) for every tile. Each worker starts on a contiguous block
+// of tiles in its own deque and takes from the front; once empty it steals from
+// the back of the other deques. A begun trace receives one WorkerTrace per worker.
+void run_tiles(const std::vector<Tile> &tiles, int num_workers,
+               const std::function<void(int, const Tile &)> &body,
+               SchedulerStats *stats = nullptr, ThreadPool *pool = nullptr, RunTrace *trace = nullptr);
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compute.hpp"
+
+// Wire format of the match server. Both ends run on one machine, so fields are in
+// native byte order. A request is a RequestHeader, scene_bytes of scene name and
+// s_rows * s_cols template pixels (one byte each, row-major). A reply is a
+// ReplyHeader, `count` WirePositions and message_bytes of error text.
+constexpr uint32_t match_request_magic = 0x51524d45; // "EMRQ"
+constexpr uint32_t match_reply_magic = 0x53524d45;   // "EMRS"
+
+enum class ServerOp : uint16_t
+{
+    Match = 1,
+    Shutdown = 2 // stop accepting, answer what is queued, exit serve()
+};
+
+struct RequestHeader
+{
+    uint32_t magic;
+    uint16_t op;     // ServerOp
+    uint16_t metric; // Metric
+    uint8_t mode;    // ResultMode
+    uint8_t reserved[3];
+    int32_t k;
+    double threshold;
+    int32_t nms_radius;
+    int32_t s_rows, s_cols;
+    uint32_t scene_bytes;
+};
+static_assert(sizeof(RequestHeader) == 40, "request header layout");
+
+struct ReplyHeader
+{
+    uint32_t magic;
+    int32_t status; // 0 = ok, otherwise the message says why
+    double best_value;
+    uint32_t count;
+    uint32_t message_bytes;
+    uint64_t queue_us;   // received -> its batch started
+    uint64_t compute_us; // its batch's matching time
+    uint32_t batch_size; // requests answered by that batch
+    uint32_t reserved;
+};
+static_assert(sizeof(ReplyHeader) == 48, "reply header layout");
+
+struct WirePosition
+{
+    int32_t i, j;
+    double value;
+};
+
+// Client side of one request
+struct MatchRequest
+{
+    std::string scene; // file stem of a loaded T, e.g. "T1_300_400"
+    Metric metric = Metric::PCC;
+    ResultOptions results;
+    int rows = 0, cols = 0;
+    std::vector<uint8_t> pixels; // rows * cols, row-major
+};
+
+struct MatchReply
+{
+    bool ok = false;
+    std::string error;
+    double best_value = 0.0;
+    std::vector<ScoredPosition> positions; // best-value ties, or the ranked results
+    double queue_ms = 0.0, compute_ms = 0.0;
+    int batch_size = 0;
+};
+
+// One connection to a running server; requests are answered in order
+class MatchClient
+{
+public:
+    explicit MatchClient(const std::string &socket_path);
+    ~MatchClient();
+    MatchClient(const MatchClient &) = delete;
+    MatchClient &operator=(const MatchClient &) = delete;
+
+    MatchReply match(const MatchRequest &request);
+    void shutdown_server();
+
+private:
+    int fd_;
+};
+
+struct Scene
+{
+    std::string name;
+    Matrix T;
+};
+
+struct ServerOptions
+{
+    std::string socket_path;
+    int batch_window_us = 200; // after the first queued request, wait this long for more
+    int max_batch = 256;
+};
+
+// Serve match requests against the resident scenes until a Shutdown request,
+// SIGINT or SIGTERM. One thread per connection reads requests into a shared
+// queue; a dispatcher takes the queue in batches. In a batch, best-value requests
+// on the same scene and metric share one compute_batch pass over T; ranked
+// requests run through a Matcher each. Every pass uses the whole pool. Latency
+// percentiles are printed on exit.
+void serve(const std::vector<Scene> &scenes, ThreadPool &pool, const ServerOptions &options);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "compute.hpp"
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// Best instruction set supported by the running CPU
+SimdLevel detect_simd_level();
+const char *simd_level_name(SimdLevel level);
+
+// SIMD engine: uint8 T is read in place (other widths are converted first) and
+// many adjacent window positions are scored at once with pmaddubsw
+// multiply-accumulate in 16-bit lanes. Integer window sums are exact, so results
+// are bit-identical for every SimdLevel.
+void compute_simd(const Matrix &S, const Matrix &T, Metric metric,
+                  std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                  SimdLevel level, ThreadPool *pool = nullptr);
+void compute_simd(const Matrix &S, const Matrix &T, Metric metric,
+                  std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                  ThreadPool *pool = nullptr);
+
+#endif
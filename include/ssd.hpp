@@ -5,5 +5,6 @@
 
 double compute_ssd(const std::vector<int> &X, const std::vector<int> &Y);
 double compute_ssd_parallel(const std::vector<int> &X, const std::vector<int> &Y);
+double ssd_from_sums(long long sum_XX, long long sum_YY, long long sum_XY);
 
 #endif
\ No newline at end of file
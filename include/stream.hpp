@@ -0,0 +1,63 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "compute.hpp"
+#include "matfile.hpp"
+
+// Sequential reader of matrix rows from a .txt or .bin file. Only the rows asked
+// for are held in memory, so a file far larger than RAM can be consumed in bands.
+class RowStream
+{
+public:
+    RowStream(const std::string &filename, int rows, int cols);
+    ~RowStream();
+    RowStream(const RowStream &) = delete;
+    RowStream &operator=(const RowStream &) = delete;
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int next_row() const { return next_row_; }
+
+    // Read the next `count` rows of the file into rows [first, first + count) of `band`
+    void read(Matrix &band, int first, int count);
+
+private:
+    void read_text(Matrix &band, int first, int count);
+    void read_binary(Matrix &band, int first, int count);
+
+    std::string filename_;
+    int rows_, cols_;
+    int next_row_ = 0;
+    std::vector<uint8_t> values_; // one unpacked row
+    // Text files
+    std::ifstream text_;
+    std::string line_;
+    // Binary caches
+    int fd_ = -1;
+    MatrixFileHeader header_;
+    std::vector<uint8_t> raw_;
+};
+
+struct StreamStats
+{
+    int bands = 0;
+    int band_rows = 0;         // output rows per band
+    size_t buffer_bytes = 0;   // both band buffers together: the peak T footprint
+    double load_seconds = 0;   // time spent reading bands (overlapped with scoring)
+    double stall_seconds = 0;  // time scoring waited for a band that was not ready
+};
+
+// Match S against the T stored in T_file without ever loading all of T. T is read
+// in horizontal bands of band_rows output rows plus the S_rows - 1 overlap rows,
+// double-buffered so the next band loads while the current one is scored with
+// compute_parallel. band_rows <= 0 picks bands of about 64 MB.
+void compute_streaming(const Matrix &S, const std::string &T_file, int T_rows, int T_cols, Metric metric,
+                       ElementWidth width, int band_rows,
+                       std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                       ThreadPool *pool = nullptr, StreamStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <vector>
+
+// Single-use countdown: wait() returns once count_down() has been called `count` times
+class Latch
+{
+public:
+    explicit Latch(int count) : count_(count) {}
+    void count_down();
+    void wait();
+
+private:
+    int count_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// Persistent pthread workers, each with its own task queue. Tasks are pinned to a
+// worker index, so a batch sent to workers [0, k) runs on exactly k threads while
+// the rest of the pool stays asleep.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int num_workers);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()); }
+
+    // Queue a task on one worker (index taken modulo size())
+    void submit(int worker, std::function<void()> task);
+    // Run body(k) for k in [0, count) with task k on worker k % size(), and wait for
+    // all of them. The first exception thrown by a task is rethrown here.
+    // Must not be called from inside a pool task.
+    void run(int count, const std::function<void(int)> &body);
+
+private:
+    struct Worker
+    {
+        pthread_t thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        bool stop = false;
+    };
+
+    static void *worker_main(void *arg);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <string>
+#include <vector>
+
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+// One online logical CPU as reported under /sys/devices/system
+struct CpuInfo
+{
+    int cpu;
+    int core;    // physical core id, unique across packages
+    int package; // socket
+    int node;    // NUMA node
+    int smt;     // index among the SMT siblings of its core (0 = first)
+};
+
+struct Topology
+{
+    std::vector<CpuInfo> cpus; // sorted by CPU number
+    int packages = 1, cores = 1, nodes = 1;
+
+    // Read once from sysfs; without sysfs every CPU is its own core on node 0
+    static const Topology &detect();
+    // "2 packages, 16 cores, 32 CPUs, 2 NUMA nodes"
+    std::string describe() const;
+};
+
+// Worker placement policies
+enum class Placement
+{
+    None,      // leave placement to the OS
+    Compact,   // fill one core's SMT siblings, then the next core, socket by socket
+    Scatter,   // round-robin over sockets and cores, SMT siblings last
+    Physical,  // one CPU per physical core, SMT siblings never used
+    NumaLocal  // compact within NUMA nodes, workers spread evenly over the nodes; T is first-touched per band
+};
+
+// "none", "compact", "scatter", "physical" or "numa"; throws std::runtime_error
+Placement parse_placement(const std::string &name);
+const char *placement_name(Placement placement);
+
+// CPU for worker k is cpus[k % cpus.size()]; empty for Placement::None
+std::vector<int> placement_cpus(const Topology &topology, Placement placement);
+
+// Pin pool worker k to placement_cpus()[k], or release every worker to all CPUs
+// for Placement::None. Returns the CPU list used.
+std::vector<int> apply_placement(ThreadPool &pool, Placement placement);
+
+// Copy T into fresh pages filled by `bands` pool workers, one contiguous row band
+// each, so with pinned workers every band lands on the node of the worker whose
+// tiles cover it (run_tiles hands worker w the w-th block of row-major tiles)
+Matrix node_local_copy(const Matrix &T, int bands, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measurements of one worker in a traced run; times are seconds since RunTrace::begin()
+struct WorkerTrace
+{
+    double start = -1, end = -1; // first and last moment inside the worker
+    double busy = 0;             // time spent inside tile bodies
+    int tiles = 0;
+    long long windows = 0;       // match positions scored
+    std::vector<std::pair<double, double>> spans; // tile intervals, for the timeline
+    // Hardware counters over the worker's lifetime, -1 when unavailable
+    long long cycles = -1, instructions = -1, llc_misses = -1, stalled_cycles = -1;
+};
+
+// Opt-in instrumentation for one parallel call. Pass a RunTrace to compute_parallel
+// or Matcher::match to fill it; with no trace the hot path only tests a null pointer.
+struct RunTrace
+{
+    std::string name;
+    bool counters = false; // read cycles / instructions / LLC misses / stalls via perf_event_open
+    double origin = 0;     // begin() time, seconds since the process-wide trace epoch
+    double total = 0;      // begin() to the end of the merge
+    double merge = 0;      // merging the per-worker results
+    std::vector<WorkerTrace> workers;
+
+    // Start the clock; run_tiles sizes `workers`
+    void begin();
+    // Seconds since begin()
+    double now() const;
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Per-thread hardware counters of the calling thread; silently unavailable when the
+// kernel refuses perf_event_open (no permission, no PMU in a VM, ...)
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Scaled counts since construction into the worker's counter fields
+    void read(WorkerTrace &worker) const;
+
+private:
+    int fds_[4];
+};
+
+// Per-worker table plus load imbalance (max busy / mean busy), thread start-up
+// latency and merge time
+void print_trace_report(const RunTrace &trace, std::ostream &out);
+// Chrome trace-event JSON (chrome://tracing, Perfetto): one process per run, one
+// track per worker with a slice per tile, and the merge on its own track
+void write_chrome_trace(const std::string &filename, const std::vector<RunTrace> &traces);
+
+#endif
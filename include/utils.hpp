@@ -7,8 +7,13 @@
 #include <vector>
 #include <utility>
 #include <filesystem>
+#include <functional>
 #include <regex>
 
+#include "compute.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
 namespace fs = std::filesystem;
 
 void parse_filename(const std::string &filename, int &rows, int &cols);
@@ -18,9 +23,48 @@ void find_files(const std::string &folder, std::string &S_file, std::string &T_f
 void read_arrays(const std::string &S_file, const std::string &T_file,
                  int S_rows, int S_cols, int T_rows, int T_cols,
                  std::vector<int> &S, std::vector<int> &T);
+// Every matrix file "<prefix>*_<rows>_<cols>.txt|.bin" in the folder, sorted, with a
+// fresh .bin cache preferred over its text file
+std::vector<std::string> find_matrix_files(const std::string &folder_path, char prefix);
+// Template files ("S*"); throws std::runtime_error when there are none
+std::vector<std::string> find_template_files(const std::string &folder_path);
+// Parse one "d,d,...,d" line into out (at most `capacity` values); returns the
+// column count or -1 with `error` set
+int parse_line(const char *p, const char *end, uint8_t *out, int capacity, std::string &error);
+// A newline-aligned slice of a text matrix file
+struct ParseChunk
+{
+    const char *begin, *end;
+    int first_row; // matrix row of the chunk's first line
+    int lines = 0; // lines in the chunk (pass 1)
+    int rows = 0;  // rows parsed so far (pass 2)
+    int cols = -1;
+    std::string error;
+};
+// Cut [begin, end) into up to num_chunks newline-aligned chunks and count their
+// lines in parallel, so every chunk knows its first row
+std::vector<ParseChunk> split_text_chunks(const char *begin, const char *end, int num_chunks, int threads_count,
+                                          ThreadPool *pool = nullptr);
+// Parse a chunk's lines into matrix rows; progress(rows parsed) is called every
+// 64 rows and once at the end. Stops at the first error, leaving it in chunk.error.
+void parse_chunk(ParseChunk &chunk, Matrix &matrix, int expected_cols,
+                 const std::function<void(int)> &progress = nullptr);
+// Throw on the first chunk error or column disagreement; returns the column count
+int check_chunks(const std::vector<ParseChunk> &chunks, const std::string &filename);
+// mmap the text file and parse newline-aligned chunks on parallel threads
+Matrix load_matrix(const std::string &filename, int expected_rows, int expected_cols,
+                   ElementWidth width, int threads_count, ThreadPool *pool = nullptr);
+// One matrix from a .bin cache (mapped) or a text file (parsed)
+Matrix read_matrix(const std::string &filename, int rows, int cols, ElementWidth width, int threads_count,
+                   ThreadPool *pool = nullptr);
+void read_arrays(const std::string &S_file, const std::string &T_file,
+                 int S_rows, int S_cols, int T_rows, int T_cols,
+                 Matrix &S, Matrix &T, ElementWidth width, ThreadPool *pool = nullptr);
 std::string get_positions_str(const std::vector<std::pair<int, int>> &positions);
 void display_results(const std::string &method, const std::vector<std::pair<int, int>> &best_positions,
                      double best_value, double time);
+// Best-first list of a top-K / threshold run, one "value (i,j)" per line
+void display_ranked_results(const std::string &method, const std::vector<ScoredPosition> &results, double time);
 void reset_csv(const std::string &data_path);
 void write_to_csv(const std::string &filename, int S_rows, int S_cols, int T_rows, int T_cols,
                   const std::string &method, int threads_count, const std::vector<std::pair<int, int>> &best_positions, double best_value, double time);
@@ -1,6 +1,7 @@
 import pandas as pd
 import matplotlib.pyplot as plt
 import glob
+import json
 import os
 import re
 from typing import Tuple, List, Optional
@@ -189,8 +190,71 @@ def plot_csv_data(ax: Axes, f: str) -> None:
     ax.tick_params(axis="both", labelsize=7)
 
 
+def load_bench_json(f: str) -> pd.DataFrame:
+    with open(f) as fp:
+        data = json.load(fp)
+    return pd.DataFrame(data.get("results", []))
+
+
+def plot_bench_json(f: str) -> None:
+    df: pd.DataFrame = load_bench_json(f)
+    if df.empty or not all(
+        c in df.columns
+        for c in ["dataset", "engine", "method", "threads", "min", "median", "p95"]
+    ):
+        print("Invalid bench file: {0}".format(f))
+        return
+    groups = list(
+        df.groupby(["dataset", "s_rows", "s_cols", "t_rows", "t_cols"], sort=False)
+    )
+    n: int = len(groups)
+    fig, axes = plt.subplots(1, n, figsize=(5 * n, 5))
+    axes = [axes] if n == 1 else axes
+    for ax, ((dataset, s_rows, s_cols, t_rows, t_cols), d) in zip(axes, groups):
+        if "placement" not in d.columns:
+            d = d.assign(placement="none")
+        for (engine, method, placement), g in d.groupby(
+            ["engine", "method", "placement"], sort=False
+        ):
+            g = g.sort_values("threads")
+            # 誤差線: 最小值到 p95
+            ax.errorbar(
+                g["threads"],
+                g["median"],
+                yerr=[g["median"] - g["min"], g["p95"] - g["median"]],
+                marker="o",
+                capsize=3,
+                label=(
+                    "{0} {1}".format(engine, method)
+                    if placement == "none"
+                    else "{0} {1} ({2})".format(engine, method, placement)
+                ),
+                linewidth=1.5,
+                markersize=4,
+            )
+        ax.set_title(
+            "{0} ({1}x{2}, {3}x{4})".format(dataset, s_rows, s_cols, t_rows, t_cols),
+            fontsize=10,
+            pad=5,
+        )
+        ax.set_xlabel("Threads", fontsize=8)
+        ax.set_ylabel("Median time (s)", fontsize=8)
+        ax.grid(True, linestyle="--", alpha=0.7)
+        ax.legend(fontsize=8)
+        ax.tick_params(axis="both", labelsize=7)
+    fig.suptitle("Threads vs Median Time (bars: min to p95)", fontsize=14, y=1.02)
+    plt.tight_layout()
+    png_file: str = os.path.splitext(f)[0] + "_threads_vs_time.png"
+    plt.savefig(png_file, dpi=300, bbox_inches="tight")
+    plt.close()
+    print("Generated: {0}".format(png_file))
+
+
 def main() -> None:
     os.makedirs("outputs", exist_ok=True)
+    # benchmark 輸出的 JSON
+    for f in sorted(glob.glob("outputs/*.json")):
+        plot_bench_json(f)
     csv_files: List[str] = sorted(glob.glob("outputs/*.csv"))
     if not csv_files:
         print("No CSVs in outputs/")
@@ -0,0 +1,150 @@
+#include "batch.hpp"
+#include "kernel.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+BatchTemplate prepare_template(const Matrix &S, const std::string &name)
+{
+    if (S.empty())
+    {
+        throw std::invalid_argument("Template is empty: " + name);
+    }
+    BatchTemplate t;
+    t.name = name;
+    t.rows = S.rows();
+    t.cols = S.cols();
+    t.values = S.to_vector();
+    for (int y : t.values)
+    {
+        t.sum_Y += y;
+        t.sum_YY += static_cast<long long>(y) * y;
+    }
+    return t;
+}
+
+namespace
+{
+    // Score template `t` at positions [i0, i1) x [j0, j1); `window` points at pixel (i0, j0).
+    // SAD needs only Σ|X-Y|, the other metrics only the moments.
+    template <int R, int C, bool WithSAD, class Pixel>
+    void batch_tile(const BatchTemplate &t, Metric metric, const Pixel *window, size_t stride,
+                    int i0, int i1, int j0, int j1, LocalBest &local)
+    {
+        const int n = t.rows * t.cols;
+        const bool find_max = metric_find_max(metric);
+        scan_tile<WindowSums<!WithSAD, WithSAD>, R, C>(
+            window, stride, t.values.data(), t.rows, t.cols, i0, i1, j0, j1,
+            [&](const WindowSums<!WithSAD, WithSAD> &sums, int i, int j)
+            {
+                update_best(sums.score(metric, n, t.sum_Y, t.sum_YY), i, j, find_max, local.value, local.positions);
+            });
+    }
+
+    template <class Pixel>
+    using BatchTileFunc = void (*)(const BatchTemplate &, Metric, const Pixel *, size_t, int, int, int, int, LocalBest &);
+
+    template <class Pixel>
+    BatchTileFunc<Pixel> select_batch(int S_rows, int S_cols, bool with_sad)
+    {
+        return dispatch_shape(S_rows, S_cols, [with_sad](auto R, auto C)
+                              { return with_sad ? batch_tile<R, C, true, Pixel> : batch_tile<R, C, false, Pixel>; });
+    }
+}
+
+void compute_batch(const std::vector<BatchTemplate> &templates, const Matrix &T, Metric metric,
+                   std::vector<TemplateResult> &results, int threads_count, ThreadPool *pool, SchedulerStats *stats)
+{
+    if (templates.empty())
+    {
+        throw std::invalid_argument("Batch needs at least one template");
+    }
+    int min_rows = T.rows(), min_cols = T.cols(), max_rows = 0, max_cols = 0;
+    for (const auto &t : templates)
+    {
+        if (t.rows <= 0 || t.cols <= 0 || t.rows > T.rows() || t.cols > T.cols())
+        {
+            throw std::invalid_argument("Template does not fit in T: " + t.name);
+        }
+        min_rows = std::min(min_rows, t.rows);
+        min_cols = std::min(min_cols, t.cols);
+        max_rows = std::max(max_rows, t.rows);
+        max_cols = std::max(max_cols, t.cols);
+    }
+
+    const bool with_sad = metric == Metric::SAD;
+    const bool find_max = metric_find_max(metric);
+    std::vector<BatchTileFunc<int32_t>> int_tiles;
+    std::vector<BatchTileFunc<uint8_t>> byte_tiles;
+    for (const auto &t : templates)
+    {
+        int_tiles.push_back(select_batch<int32_t>(t.rows, t.cols, with_sad));
+        byte_tiles.push_back(select_batch<uint8_t>(t.rows, t.cols, with_sad));
+    }
+
+    // 以最小樣板的輸出範圍切 tile，足跡按最大樣板估算
+    const int max_i = T.rows() - min_rows + 1;
+    const int max_j = T.cols() - min_cols + 1;
+    int num_workers = resolve_thread_count(threads_count, max_i * max_j, pool);
+    std::vector<Tile> tiles = make_tiles(max_i, max_j, max_rows, max_cols, T.width(), num_workers);
+
+    const LocalBest reset{find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max(), {}};
+    std::vector<std::vector<LocalBest>> locals(num_workers, std::vector<LocalBest>(templates.size(), reset));
+    std::vector<std::vector<uint8_t>> unpacked(num_workers);
+    run_tiles(
+        tiles, num_workers,
+        [&](int worker, const Tile &tile)
+        {
+            // Nibble tiles are unpacked once for every template
+            const uint8_t *nibble_window = nullptr;
+            size_t nibble_stride = 0;
+            if (T.width() == ElementWidth::Nibble)
+            {
+                int rows = std::min(tile.i1 + max_rows - 1, T.rows()) - tile.i0;
+                int cols = std::min(tile.j1 + max_cols - 1, T.cols()) - tile.j0;
+                unpack_tile(T, tile.i0, tile.j0, rows, cols, unpacked[worker]);
+                nibble_window = unpacked[worker].data();
+                nibble_stride = cols;
+            }
+            for (size_t k = 0; k < templates.size(); ++k)
+            {
+                const BatchTemplate &t = templates[k];
+                int i1 = std::min(tile.i1, T.rows() - t.rows + 1);
+                int j1 = std::min(tile.j1, T.cols() - t.cols + 1);
+                if (tile.i0 >= i1 || tile.j0 >= j1)
+                {
+                    continue;
+                }
+                LocalBest &local = locals[worker][k];
+                switch (T.width())
+                {
+                case ElementWidth::Int32:
+                    int_tiles[k](t, metric, T.row<int32_t>(tile.i0) + tile.j0, T.stride() / sizeof(int32_t),
+                                 tile.i0, i1, tile.j0, j1, local);
+                    break;
+                case ElementWidth::UInt8:
+                    byte_tiles[k](t, metric, T.row<uint8_t>(tile.i0) + tile.j0, T.stride(),
+                                  tile.i0, i1, tile.j0, j1, local);
+                    break;
+                default:
+                    byte_tiles[k](t, metric, nibble_window, nibble_stride, tile.i0, i1, tile.j0, j1, local);
+                    break;
+                }
+            }
+        },
+        stats, pool);
+
+    // 合併結果
+    results.clear();
+    for (size_t k = 0; k < templates.size(); ++k)
+    {
+        TemplateResult merged{templates[k].name, reset.value, {}};
+        for (const auto &worker_locals : locals)
+        {
+            merge_best(worker_locals[k].value, worker_locals[k].positions, find_max, merged.best_value,
+                       merged.best_positions);
+        }
+        std::sort(merged.best_positions.begin(), merged.best_positions.end());
+        results.push_back(std::move(merged));
+    }
+}
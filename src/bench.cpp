@@ -0,0 +1,130 @@
+#include "bench.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+BenchStats summarize_samples(std::vector<double> samples)
+{
+    BenchStats stats;
+    if (samples.empty())
+    {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    stats.min = samples.front();
+    stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    stats.p95 = samples[std::min(n - 1, static_cast<size_t>(std::ceil(0.95 * n)) - 1)];
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+    double sum_sq = 0.0;
+    for (double sample : samples)
+    {
+        sum_sq += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.stddev = n > 1 ? std::sqrt(sum_sq / (n - 1)) : 0.0;
+    return stats;
+}
+
+Matrix synthetic_matrix(int rows, int cols, ElementWidth width, unsigned seed)
+{
+    Matrix m(rows, cols, width);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pixel(0, 9);
+    std::vector<uint8_t> row(cols);
+    for (int r = 0; r < rows; ++r)
+    {
+        for (auto &value : row)
+        {
+            value = static_cast<uint8_t>(pixel(rng));
+        }
+        m.pack_row(r, row.data());
+    }
+    return m;
+}
+
+Matrix synthetic_template(const Matrix &T, int rows, int cols, unsigned seed)
+{
+    if (rows <= 0 || cols <= 0 || rows > T.rows() || cols > T.cols())
+    {
+        throw std::invalid_argument("Synthetic template does not fit in T");
+    }
+    std::mt19937 rng(seed ^ 0x9e3779b9u);
+    int i = std::uniform_int_distribution<int>(0, T.rows() - rows)(rng);
+    int j = std::uniform_int_distribution<int>(0, T.cols() - cols)(rng);
+    Matrix S(rows, cols, T.width());
+    std::vector<uint8_t> row(cols);
+    for (int r = 0; r < rows; ++r)
+    {
+        T.unpack_row(i + r, j, cols, row.data());
+        S.pack_row(r, row.data());
+    }
+    return S;
+}
+
+// Flat-image runs can tie at every position; only the first few go to the file
+static const size_t max_json_positions = 16;
+
+// JSON string literal with the escapes dataset paths can need
+static std::string json_string(const std::string &text)
+{
+    std::string out = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+void write_bench_json(const std::string &filename, const BenchSetup &setup, const std::vector<BenchRecord> &records)
+{
+    fs::path path(filename);
+    if (path.has_parent_path())
+    {
+        fs::create_directories(path.parent_path());
+    }
+    std::ofstream out(filename, std::ios::trunc);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    out << std::setprecision(9);
+    out << "{\n  \"setup\": {\"cores\": " << setup.cores << ", \"storage\": " << json_string(setup.storage)
+        << ", \"warmup\": " << setup.warmup << ", \"repetitions\": " << setup.repetitions << "},\n";
+    out << "  \"results\": [";
+    for (size_t k = 0; k < records.size(); ++k)
+    {
+        const BenchRecord &r = records[k];
+        out << (k ? ",\n" : "\n") << "    {\"dataset\": " << json_string(r.dataset)
+            << ", \"engine\": " << json_string(r.engine) << ", \"method\": " << json_string(r.method)
+            << ", \"placement\": " << json_string(r.placement)
+            << ", \"s_rows\": " << r.S_rows << ", \"s_cols\": " << r.S_cols << ", \"t_rows\": " << r.T_rows
+            << ", \"t_cols\": " << r.T_cols << ", \"threads\": " << r.threads
+            << ", \"min\": " << r.stats.min << ", \"median\": " << r.stats.median << ", \"p95\": " << r.stats.p95
+            << ", \"mean\": " << r.stats.mean << ", \"stddev\": " << r.stats.stddev
+            << ", \"windows_per_second\": " << r.windows_per_second << ", \"gb_per_second\": " << r.gb_per_second
+            << ", \"best_value\": " << r.best_value
+            << ", \"best_count\": " << r.best_positions.size() << ", \"best_positions\": "
+            << json_string(get_positions_str(std::vector<std::pair<int, int>>(
+                   r.best_positions.begin(),
+                   r.best_positions.begin() + std::min<size_t>(r.best_positions.size(), max_json_positions))))
+            << ", \"samples\": [";
+        for (size_t s = 0; s < r.samples.size(); ++s)
+        {
+            out << (s ? ", " : "") << r.samples[s];
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
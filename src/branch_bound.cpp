@@ -0,0 +1,179 @@
+#include "branch_bound.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+namespace
+{
+    // A run of template pixels along one row, visited as a unit so the inner loop
+    // stays contiguous; the bound is tested after each segment
+    struct ProbeSegment
+    {
+        int row, col, length;
+        double weight; // expected SSD contribution per pixel
+    };
+
+    constexpr int segment_cols = 16;
+
+    // Mean of T over a row sample, used only to order the segments
+    double sample_mean(const Matrix &T)
+    {
+        const int step = std::max(1, T.rows() / 64);
+        std::vector<uint8_t> row(T.cols());
+        long long sum = 0, count = 0;
+        for (int r = 0; r < T.rows(); r += step)
+        {
+            T.unpack_row(r, 0, T.cols(), row.data());
+            sum = std::accumulate(row.begin(), row.end(), sum);
+            count += T.cols();
+        }
+        return count ? static_cast<double>(sum) / count : 0.0;
+    }
+
+    struct WorkerState
+    {
+        LocalBest best;
+        BoundStats counters;
+        std::vector<uint8_t> unpacked; // nibble tiles
+    };
+
+    // Bounded scan of one tile; `window` is the tile's top-left pixel
+    template <class Pixel>
+    void bounded_tile(const std::vector<ProbeSegment> &segments, const int *S, int S_cols,
+                      std::atomic<long long> &bound, const Pixel *window, size_t stride, const Tile &tile,
+                      WorkerState &state)
+    {
+        const size_t n = segments.size();
+        for (int i = tile.i0; i < tile.i1; ++i)
+        {
+            const Pixel *t_row = window + (i - tile.i0) * stride;
+            for (int j = tile.j0; j < tile.j1; ++j)
+            {
+                const Pixel *t = t_row + (j - tile.j0);
+                const long long limit = bound.load(std::memory_order_relaxed);
+                long long ssd = 0;
+                long long pixels = 0;
+                size_t p = 0;
+                while (p < n)
+                {
+                    const ProbeSegment &segment = segments[p++];
+                    const Pixel *t_seg = t + segment.row * stride + segment.col;
+                    const int *s_seg = S + segment.row * S_cols + segment.col;
+                    int partial = 0;
+                    for (int l = 0; l < segment.length; ++l)
+                    {
+                        int diff = t_seg[l] - s_seg[l];
+                        partial += diff * diff;
+                    }
+                    ssd += partial;
+                    pixels += segment.length;
+                    // Exact integer sums: a window above the bound can never tie it
+                    if (ssd > limit)
+                    {
+                        break;
+                    }
+                }
+                state.counters.pixels_evaluated += pixels;
+                if (ssd > limit)
+                {
+                    state.counters.windows_rejected += p < n;
+                    continue;
+                }
+                update_best(static_cast<double>(ssd), i, j, false, state.best.value, state.best.positions);
+                // 更新共享上界
+                long long current = limit;
+                while (ssd < current && !bound.compare_exchange_weak(current, ssd, std::memory_order_relaxed))
+                {
+                }
+            }
+        }
+        state.counters.windows += static_cast<long long>(tile.i1 - tile.i0) * (tile.j1 - tile.j0);
+    }
+}
+
+void compute_ssd_bounded(const Matrix &S, const Matrix &T,
+                         std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                         ThreadPool *pool, BoundStats *bound_stats, SchedulerStats *stats)
+{
+    validate_dimensions(S, T);
+
+    // 依期望貢獻排序：與 T 平均值差距大的片段先算
+    const double mean_T = sample_mean(T);
+    std::vector<int> S_values = S.to_vector();
+    std::vector<ProbeSegment> segments;
+    for (int r = 0; r < S.rows(); ++r)
+    {
+        for (int c = 0; c < S.cols(); c += segment_cols)
+        {
+            ProbeSegment segment{r, c, std::min(segment_cols, S.cols() - c), 0.0};
+            for (int l = 0; l < segment.length; ++l)
+            {
+                double d = S_values[r * S.cols() + c + l] - mean_T;
+                segment.weight += d * d;
+            }
+            segment.weight /= segment.length;
+            segments.push_back(segment);
+        }
+    }
+    std::stable_sort(segments.begin(), segments.end(), [](const ProbeSegment &a, const ProbeSegment &b)
+                     { return a.weight > b.weight; });
+
+    const int max_i = T.rows() - S.rows() + 1;
+    const int max_j = T.cols() - S.cols() + 1;
+    int num_workers = resolve_thread_count(threads_count, max_i * max_j, pool);
+    std::vector<Tile> tiles = make_tiles(max_i, max_j, S.rows(), S.cols(), T.width(), num_workers);
+    std::atomic<long long> bound(std::numeric_limits<long long>::max());
+    std::vector<WorkerState> states(num_workers);
+    for (auto &state : states)
+    {
+        state.best.value = std::numeric_limits<double>::max();
+    }
+
+    run_tiles(
+        tiles, num_workers,
+        [&](int worker, const Tile &tile)
+        {
+            WorkerState &state = states[worker];
+            switch (T.width())
+            {
+            case ElementWidth::Int32:
+                bounded_tile(segments, S_values.data(), S.cols(), bound, T.row<int32_t>(tile.i0) + tile.j0, T.stride() / sizeof(int32_t), tile, state);
+                break;
+            case ElementWidth::UInt8:
+                bounded_tile(segments, S_values.data(), S.cols(), bound, T.row<uint8_t>(tile.i0) + tile.j0, T.stride(), tile, state);
+                break;
+            default:
+            {
+                int rows = tile.i1 - tile.i0 + S.rows() - 1;
+                int cols = tile.j1 - tile.j0 + S.cols() - 1;
+                state.unpacked.resize(static_cast<size_t>(rows) * cols);
+                for (int r = 0; r < rows; ++r)
+                {
+                    T.unpack_row(tile.i0 + r, tile.j0, cols, state.unpacked.data() + static_cast<size_t>(r) * cols);
+                }
+                bounded_tile(segments, S_values.data(), S.cols(), bound, state.unpacked.data(), cols, tile, state);
+                break;
+            }
+            }
+        },
+        stats, pool);
+
+    // 合併結果
+    best_value = std::numeric_limits<double>::max();
+    best_positions.clear();
+    BoundStats total;
+    for (const auto &state : states)
+    {
+        merge_best(state.best.value, state.best.positions, false, best_value, best_positions);
+        total.windows += state.counters.windows;
+        total.windows_rejected += state.counters.windows_rejected;
+        total.pixels_evaluated += state.counters.pixels_evaluated;
+    }
+    std::sort(best_positions.begin(), best_positions.end());
+    total.pixels_total = total.windows * S.rows() * S.cols();
+    if (bound_stats)
+    {
+        *bound_stats = total;
+    }
+}
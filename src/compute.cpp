@@ -1,8 +1,108 @@
 #include "compute.hpp"
+#include "kernel.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <iostream>
 #include <thread>
 #include <numeric>
+#include <unordered_map>
+
+size_t resolve_thread_count(int threads_count, int max_i, const ThreadPool *pool)
+{
+    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_threads = std::min(static_cast<size_t>(std::max(threads_count, 1)), static_cast<size_t>(std::max(max_i, 1)));
+    num_threads = std::min(num_threads, static_cast<size_t>(std::max(num_cores, 1)));
+    if (pool)
+    {
+        num_threads = std::min(num_threads, static_cast<size_t>(pool->size()));
+    }
+    return std::max(size_t(1), num_threads);
+}
+
+struct RangeThreadData
+{
+    const std::function<void(int, int, int)> *body;
+    int thread, begin, end;
+};
+
+static void *range_thread_func(void *arg)
+{
+    RangeThreadData *data = (RangeThreadData *)arg;
+    (*data->body)(data->thread, data->begin, data->end);
+    return nullptr;
+}
+
+void parallel_ranges(int count, int threads_count, const std::function<void(int, int, int)> &body,
+                     ThreadPool *pool)
+{
+    size_t num_threads = resolve_thread_count(threads_count, count, pool);
+    if (pool)
+    {
+        int chunk_size = count / num_threads;
+        pool->run(num_threads, [&](int t)
+                  { body(t, t * chunk_size, (t == static_cast<int>(num_threads) - 1) ? count : (t + 1) * chunk_size); });
+        return;
+    }
+
+    std::vector<pthread_t> threads(num_threads);
+    std::vector<RangeThreadData> thread_data(num_threads);
+
+    // 拆分任務
+    int chunk_size = count / num_threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        thread_data[t].body = &body;
+        thread_data[t].thread = t;
+        thread_data[t].begin = t * chunk_size;
+        thread_data[t].end = (t == num_threads - 1) ? count : (t + 1) * chunk_size;
+    }
+
+    // Ranges whose thread failed to start run on the calling thread
+    size_t successful_threads = 1;
+    for (size_t t = 1; t < num_threads; ++t)
+    {
+        if (pthread_create(&threads[t], nullptr, range_thread_func, &thread_data[t]) != 0)
+        {
+            std::cerr << "Unable to create thread " << t << std::endl;
+            break;
+        }
+        successful_threads++;
+    }
+    range_thread_func(&thread_data[0]);
+    for (size_t t = successful_threads; t < num_threads; ++t)
+    {
+        range_thread_func(&thread_data[t]);
+    }
+    for (size_t t = 1; t < successful_threads; ++t)
+    {
+        pthread_join(threads[t], nullptr);
+    }
+}
+
+void parallel_bands(int max_i, int threads_count, bool find_max,
+                    const std::function<void(int, int, LocalBest &)> &band,
+                    std::vector<std::pair<int, int>> &best_positions, double &best_value,
+                    ThreadPool *pool)
+{
+    best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    best_positions.clear();
+
+    std::vector<LocalBest> locals(resolve_thread_count(threads_count, max_i, pool), LocalBest{best_value, {}});
+    parallel_ranges(
+        max_i, threads_count,
+        [&](int thread, int start_i, int end_i)
+        {
+            band(start_i, end_i, locals[thread]);
+        },
+        pool);
+
+    // 合併結果
+    for (const auto &local : locals)
+    {
+        merge_best(local.value, local.positions, find_max, best_value, best_positions);
+    }
+}
 
 // No parallel computation function
 void compute(const std::vector<int> &S, const std::vector<int> &T,
@@ -69,10 +169,77 @@ void compute(const std::vector<int> &S, const std::vector<int> &T,
     }
 }
 
+static void validate_dimensions(const std::vector<int> &S, const std::vector<int> &T,
+                                int S_rows, int S_cols, int T_rows, int T_cols)
+{
+    if (S_rows <= 0 || S_cols <= 0 || T_rows <= 0 || T_cols <= 0 ||
+        S_rows > T_rows || S_cols > T_cols ||
+        S.size() != static_cast<size_t>(S_rows * S_cols) ||
+        T.size() != static_cast<size_t>(T_rows * T_cols))
+    {
+        throw std::invalid_argument("Vector sizes or dimensions are invalid");
+    }
+}
+
+void require_pcc_or_ssd(Metric metric, const char *engine)
+{
+    if (metric != Metric::PCC && metric != Metric::SSD)
+    {
+        throw std::invalid_argument(std::string(metric_name(metric)) + " is not supported by the " + engine + " engine");
+    }
+}
+
+void validate_dimensions(const Matrix &S, const Matrix &T)
+{
+    if (S.empty() || T.empty() || S.rows() > T.rows() || S.cols() > T.cols())
+    {
+        throw std::invalid_argument("Matrix dimensions are invalid");
+    }
+}
+
+ComputeThreadData kernel_thread_data(const Matrix &T, const std::vector<int> &S_values,
+                                     int S_rows, int S_cols, Metric metric)
+{
+    ComputeThreadData data;
+    data.S = &S_values;
+    data.T = nullptr;
+    data.T_matrix = &T;
+    data.S_rows = S_rows;
+    data.S_cols = S_cols;
+    data.T_rows = T.rows();
+    data.T_cols = T.cols();
+    data.kernel = select_kernel(metric, S_rows, S_cols, T.width());
+    data.find_max = metric_find_max(metric);
+    data.start_j = 0;
+    data.end_j = T.cols() - S_cols + 1;
+    data.local_best_value = data.find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    return data;
+}
+
+void compute(const Matrix &S, const Matrix &T, Metric metric,
+             std::vector<std::pair<int, int>> &best_positions, double &best_value)
+{
+    validate_dimensions(S, T);
+
+    std::vector<int> S_values = S.to_vector();
+    ComputeThreadData data = kernel_thread_data(T, S_values, S.rows(), S.cols(), metric);
+    data.start_i = 0;
+    data.end_i = T.rows() - S.rows() + 1;
+    data.kernel(&data);
+
+    best_value = data.local_best_value;
+    best_positions = std::move(data.local_best_positions);
+}
+
 // Thread function
 void *compute_thread_func(void *arg)
 {
     ComputeThreadData *data = (ComputeThreadData *)arg;
+    if (data->kernel)
+    {
+        data->kernel(data);
+        return nullptr;
+    }
     const double epsilon = 1e-10;
     data->local_best_value = data->find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
     data->local_best_positions.clear();
@@ -129,104 +296,230 @@ void *compute_thread_func(void *arg)
 void compute_parallel(const std::vector<int> &S, const std::vector<int> &T,
                       int S_rows, int S_cols, int T_rows, int T_cols,
                       std::function<double(const std::vector<int> &, const std::vector<int> &)> compute_func,
-                      bool find_max, std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count)
+                      bool find_max, std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool)
 {
-    if (S_rows <= 0 || S_cols <= 0 || T_rows <= 0 || T_cols <= 0 ||
-        S_rows > T_rows || S_cols > T_cols ||
-        S.size() != static_cast<size_t>(S_rows * S_cols) ||
-        T.size() != static_cast<size_t>(T_rows * T_cols))
-    {
-        throw std::invalid_argument("Vector sizes or dimensions are invalid");
-    }
+    validate_dimensions(S, T, S_rows, S_cols, T_rows, T_cols);
 
-    const double epsilon = 1e-10;
-    best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
-    best_positions.clear();
+    ComputeThreadData proto;
+    proto.S = &S;
+    proto.T = &T;
+    proto.S_rows = S_rows;
+    proto.S_cols = S_cols;
+    proto.T_rows = T_rows;
+    proto.T_cols = T_cols;
+    proto.compute_func = compute_func;
+    proto.find_max = find_max;
+    parallel_bands(
+        T_rows - S_rows + 1, threads_count, find_max,
+        [&](int start_i, int end_i, LocalBest &local)
+        {
+            ComputeThreadData data = proto;
+            data.start_i = start_i;
+            data.end_i = end_i;
+            compute_thread_func(&data);
+            local.value = data.local_best_value;
+            local.positions = std::move(data.local_best_positions);
+        },
+        best_positions, best_value, pool);
+}
 
-    int max_i = T_rows - S_rows + 1;
-    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    size_t num_threads = std::min(static_cast<size_t>(threads_count), static_cast<size_t>(max_i));
-    num_threads = std::min(num_threads, static_cast<size_t>(num_cores));
-    num_threads = std::max(size_t(1), num_threads);
+// Run proto's kernel over cache-sized tiles through the work-stealing scheduler;
+// each worker's data accumulates across its tiles
+static std::vector<ComputeThreadData> run_tiled(const ComputeThreadData &proto, const Matrix &S, const Matrix &T,
+                                                int threads_count, ThreadPool *pool, SchedulerStats *stats,
+                                                RunTrace *trace = nullptr)
+{
+    const int max_i = T.rows() - S.rows() + 1;
+    const int max_j = T.cols() - S.cols() + 1;
+    int num_workers = resolve_thread_count(threads_count, max_i * max_j, pool);
+    std::vector<Tile> tiles = make_tiles(max_i, max_j, S.rows(), S.cols(), T.width(), num_workers);
+    std::vector<ComputeThreadData> thread_data(num_workers, proto);
+    run_tiles(
+        tiles, num_workers,
+        [&](int worker, const Tile &tile)
+        {
+            ComputeThreadData &data = thread_data[worker];
+            data.start_i = tile.i0;
+            data.end_i = tile.i1;
+            data.start_j = tile.j0;
+            data.end_j = tile.j1;
+            data.kernel(&data);
+        },
+        stats, pool, trace);
+    return thread_data;
+}
 
-    std::vector<pthread_t> threads(num_threads);
-    std::vector<ComputeThreadData> thread_data(num_threads);
+void compute_parallel(const Matrix &S, const Matrix &T, Metric metric,
+                      std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool, SchedulerStats *stats, RunTrace *trace)
+{
+    validate_dimensions(S, T);
+    if (trace)
+    {
+        trace->begin();
+    }
 
-    // 拆分任務
-    int chunk_size = max_i / num_threads;
-    for (size_t t = 0; t < num_threads; ++t)
+    std::vector<int> S_values = S.to_vector();
+    ComputeThreadData proto = kernel_thread_data(T, S_values, S.rows(), S.cols(), metric);
+    std::vector<ComputeThreadData> thread_data = run_tiled(proto, S, T, threads_count, pool, stats, trace);
+
+    double merge_start = trace ? trace->now() : 0.0;
+    best_value = proto.local_best_value;
+    best_positions.clear();
+    for (const auto &data : thread_data)
     {
-        thread_data[t].S = &S;
-        thread_data[t].T = &T;
-        thread_data[t].S_rows = S_rows;
-        thread_data[t].S_cols = S_cols;
-        thread_data[t].T_rows = T_rows;
-        thread_data[t].T_cols = T_cols;
-        thread_data[t].compute_func = compute_func;
-        thread_data[t].find_max = find_max;
-        thread_data[t].start_i = t * chunk_size;
-        thread_data[t].end_i = (t == num_threads - 1) ? max_i : (t + 1) * chunk_size;
+        merge_best(data.local_best_value, data.local_best_positions, proto.find_max, best_value, best_positions);
     }
+    // Tiles finish in any order; keep the serial row-major order
+    std::sort(best_positions.begin(), best_positions.end());
+    if (trace)
+    {
+        trace->total = trace->now();
+        trace->merge = trace->total - merge_start;
+    }
+}
 
-    size_t successful_threads = 0;
-    for (size_t t = 0; t < num_threads; ++t)
+void compute_ranked(const Matrix &S, const Matrix &T, Metric metric, const ResultOptions &options,
+                    std::vector<ScoredPosition> &results, int threads_count, ThreadPool *pool)
+{
+    validate_dimensions(S, T);
+    const bool find_max = metric_find_max(metric);
+    results.clear();
+    if (options.mode == ResultMode::Best)
     {
-        if (pthread_create(&threads[t], nullptr, compute_thread_func, &thread_data[t]) != 0)
+        std::vector<std::pair<int, int>> best_positions;
+        double best_value;
+        compute_parallel(S, T, metric, best_positions, best_value, threads_count, pool);
+        for (const auto &[i, j] : best_positions)
         {
-            std::cerr << "Unable to create thread " << t << std::endl;
-            break;
+            results.push_back({best_value, i, j});
         }
-        successful_threads++;
+        suppress_non_maxima(results, options.nms_radius);
+        return;
     }
+    validate_result_options(options);
 
-    if (successful_threads == 0)
+    std::vector<int> S_values = S.to_vector();
+    ComputeThreadData proto = kernel_thread_data(T, S_values, S.rows(), S.cols(), metric);
+    proto.kernel = select_kernel(metric, S.rows(), S.cols(), T.width(), true);
+    const ResultOptions candidates = ranked_candidates(options);
+    proto.result_options = &candidates;
+    std::vector<ComputeThreadData> thread_data = run_tiled(proto, S, T, threads_count, pool, nullptr);
+
+    std::vector<std::vector<ScoredPosition>> lists;
+    for (auto &data : thread_data)
     {
-        std::cerr << "Failed to create any threads, exiting." << std::endl;
-        return;
+        lists.push_back(std::move(data.local_results));
     }
+    merge_ranked(lists, options, find_max, results, threads_count, pool);
+}
 
-    for (size_t t = 0; t < successful_threads; ++t)
+void validate_result_options(const ResultOptions &options)
+{
+    if (options.mode != ResultMode::Best && options.k <= 0)
     {
-        pthread_join(threads[t], nullptr);
+        throw std::invalid_argument("Top-K and threshold modes need k > 0");
     }
+}
 
-    // 預先分配空間
-    best_positions.reserve(std::accumulate(thread_data.begin(), thread_data.begin() + successful_threads, 0,
-                                           [](size_t sum, const ComputeThreadData &data)
-                                           {
-                                               return sum + data.local_best_positions.size();
-                                           }));
-
-    // 合併結果
-    for (size_t t = 0; t < successful_threads; ++t)
-    {
-        if (find_max)
+void merge_ranked(std::vector<std::vector<ScoredPosition>> &lists, const ResultOptions &options, bool find_max,
+                  std::vector<ScoredPosition> &results, int threads_count, ThreadPool *pool)
+{
+    auto cmp = [find_max](const ScoredPosition &a, const ScoredPosition &b)
+    { return ranks_before(a, b, find_max); };
+    const int keep = ranked_candidates(options).k;
+    parallel_ranges(
+        lists.size(), threads_count,
+        [&](int, int begin, int end)
         {
-            if (thread_data[t].local_best_value > best_value + epsilon)
+            for (int k = begin; k < end; ++k)
             {
-                best_value = thread_data[t].local_best_value;
-                best_positions = thread_data[t].local_best_positions;
+                std::sort_heap(lists[k].begin(), lists[k].end(), cmp);
             }
-            else if (std::abs(thread_data[t].local_best_value - best_value) < epsilon)
+        },
+        pool);
+
+    // 兩兩平行合併，每輪串列數減半
+    while (lists.size() > 1)
+    {
+        std::vector<std::vector<ScoredPosition>> merged((lists.size() + 1) / 2);
+        parallel_ranges(
+            lists.size() / 2, threads_count,
+            [&](int, int begin, int end)
             {
-                best_positions.insert(best_positions.end(),
-                                      thread_data[t].local_best_positions.begin(),
-                                      thread_data[t].local_best_positions.end());
-            }
+                for (int p = begin; p < end; ++p)
+                {
+                    const auto &a = lists[2 * p], &b = lists[2 * p + 1];
+                    merged[p].resize(a.size() + b.size());
+                    std::merge(a.begin(), a.end(), b.begin(), b.end(), merged[p].begin(), cmp);
+                    if (merged[p].size() > static_cast<size_t>(keep))
+                    {
+                        merged[p].resize(keep);
+                    }
+                }
+            },
+            pool);
+        if (lists.size() % 2)
+        {
+            merged.back() = std::move(lists.back());
         }
-        else
+        lists = std::move(merged);
+    }
+    results.clear();
+    if (!lists.empty())
+    {
+        results = std::move(lists[0]);
+    }
+    // 先抑制再截斷，群聚的結果不會讓數量少於 k
+    suppress_non_maxima(results, options.nms_radius);
+    if (results.size() > static_cast<size_t>(options.k))
+    {
+        results.resize(options.k);
+    }
+}
+
+void suppress_non_maxima(std::vector<ScoredPosition> &results, int radius)
+{
+    if (radius <= 0 || results.empty())
+    {
+        return;
+    }
+    // Kept positions bucketed on a grid of radius-sized cells: only the 3x3
+    // neighbouring cells can hold a suppressor
+    const long long cell = radius;
+    std::unordered_map<long long, std::vector<std::pair<int, int>>> grid;
+    auto key = [](long long r, long long c)
+    { return (r << 32) ^ (c & 0xffffffffLL); };
+    std::vector<ScoredPosition> kept;
+    for (const auto &candidate : results)
+    {
+        long long r = candidate.i / cell, c = candidate.j / cell;
+        bool suppressed = false;
+        for (long long dr = -1; dr <= 1 && !suppressed; ++dr)
         {
-            if (thread_data[t].local_best_value < best_value - epsilon)
+            for (long long dc = -1; dc <= 1 && !suppressed; ++dc)
             {
-                best_value = thread_data[t].local_best_value;
-                best_positions = thread_data[t].local_best_positions;
-            }
-            else if (std::abs(thread_data[t].local_best_value - best_value) < epsilon)
-            {
-                best_positions.insert(best_positions.end(),
-                                      thread_data[t].local_best_positions.begin(),
-                                      thread_data[t].local_best_positions.end());
+                auto it = grid.find(key(r + dr, c + dc));
+                if (it == grid.end())
+                {
+                    continue;
+                }
+                for (const auto &[i, j] : it->second)
+                {
+                    if (std::abs(i - candidate.i) <= radius && std::abs(j - candidate.j) <= radius)
+                    {
+                        suppressed = true;
+                        break;
+                    }
+                }
             }
         }
+        if (!suppressed)
+        {
+            grid[key(r, c)].push_back({candidate.i, candidate.j});
+            kept.push_back(candidate);
+        }
     }
-}
\ No newline at end of file
+    results = std::move(kept);
+}
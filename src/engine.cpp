@@ -0,0 +1,176 @@
+#include "engine.hpp"
+#include "branch_bound.hpp"
+#include "exact.hpp"
+#include "fft.hpp"
+#include "integral.hpp"
+#include "matcher.hpp"
+#include "pyramid.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+Engine parse_engine(const std::string &name)
+{
+    if (name == "direct")
+    {
+        return Engine::Direct;
+    }
+    if (name == "integral")
+    {
+        return Engine::Integral;
+    }
+    if (name == "fft")
+    {
+        return Engine::FFT;
+    }
+    if (name == "simd")
+    {
+        return Engine::SIMD;
+    }
+    if (name == "bnb")
+    {
+        return Engine::BranchBound;
+    }
+    if (name == "exact")
+    {
+        return Engine::Exact;
+    }
+    if (name == "pyramid")
+    {
+        return Engine::Pyramid;
+    }
+    if (name == "stream")
+    {
+        return Engine::Stream;
+    }
+    throw std::runtime_error("Unknown engine: " + name);
+}
+
+std::string engine_name(Engine engine)
+{
+    switch (engine)
+    {
+    case Engine::Integral:
+        return "integral";
+    case Engine::FFT:
+        return "fft";
+    case Engine::SIMD:
+        return std::string("simd (") + simd_level_name(detect_simd_level()) + ")";
+    case Engine::BranchBound:
+        return "bnb (SSD bounded, other metrics direct)";
+    case Engine::Pyramid:
+        return "pyramid";
+    case Engine::Stream:
+        return "stream";
+    case Engine::Exact:
+        return "exact (SSD by rolling hash, direct when S does not occur)";
+    default:
+        return "direct";
+    }
+}
+
+const char *engine_option(Engine engine)
+{
+    switch (engine)
+    {
+    case Engine::Integral:
+        return "integral";
+    case Engine::FFT:
+        return "fft";
+    case Engine::SIMD:
+        return "simd";
+    case Engine::BranchBound:
+        return "bnb";
+    case Engine::Pyramid:
+        return "pyramid";
+    case Engine::Stream:
+        return "stream";
+    case Engine::Exact:
+        return "exact";
+    default:
+        return "direct";
+    }
+}
+
+std::vector<Metric> parse_metrics(const std::string &list)
+{
+    std::vector<Metric> metrics;
+    std::stringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ','))
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        bool found = false;
+        for (Metric metric : {Metric::PCC, Metric::SSD, Metric::SAD, Metric::NCC})
+        {
+            if (name == metric_name(metric))
+            {
+                if (std::find(metrics.begin(), metrics.end(), metric) == metrics.end())
+                {
+                    metrics.push_back(metric);
+                }
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            throw std::runtime_error("Unknown metric: " + name);
+        }
+    }
+    if (metrics.empty())
+    {
+        throw std::runtime_error("No metrics given");
+    }
+    return metrics;
+}
+
+void run_engine(Engine engine, Metric metric, const Matrix &S, const Matrix &T,
+                std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                ThreadPool *pool)
+{
+    best_positions.clear();
+    switch (engine)
+    {
+    case Engine::Stream:
+        throw std::invalid_argument("The stream engine reads T from its file and cannot run on a loaded matrix");
+    case Engine::Integral:
+        compute_integral(S, T, metric, best_positions, best_value, threads_count, pool);
+        return;
+    case Engine::FFT:
+        compute_fft(S, T, metric, best_positions, best_value, threads_count, pool);
+        return;
+    case Engine::SIMD:
+        compute_simd(S, T, metric, best_positions, best_value, threads_count, pool);
+        return;
+    case Engine::Pyramid:
+        compute_pyramid(S, T, metric, best_positions, best_value, threads_count, pool);
+        return;
+    case Engine::BranchBound:
+        if (metric == Metric::SSD)
+        {
+            compute_ssd_bounded(S, T, best_positions, best_value, threads_count, pool);
+            return;
+        }
+        break;
+    case Engine::Exact:
+        if (metric == Metric::SSD)
+        {
+            compute_exact(S, T, best_positions, threads_count, pool);
+            if (!best_positions.empty())
+            {
+                best_value = 0.0; // S occurs verbatim
+                return;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    MatchOptions options;
+    options.threads = threads_count;
+    options.pool = pool;
+    MatchResult result = Matcher(S, metric).match(T, options);
+    best_value = result.best_value;
+    best_positions = std::move(result.best_positions);
+}
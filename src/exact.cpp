@@ -0,0 +1,173 @@
+#include "exact.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+    // Odd multipliers; arithmetic wraps modulo 2^64
+    constexpr uint64_t row_base = 0x9e3779b97f4a7c15ULL;
+    constexpr uint64_t col_base = 0xc2b2ae3d27d4eb4fULL;
+
+    uint64_t power(uint64_t base, int exponent)
+    {
+        uint64_t result = 1;
+        for (int k = 0; k < exponent; ++k)
+        {
+            result *= base;
+        }
+        return result;
+    }
+
+    // Yields row r of a matrix as ints, in place when the width allows it
+    class RowReader
+    {
+    public:
+        explicit RowReader(const Matrix &m) : m_(m), buffer_(m.width() == ElementWidth::Nibble ? m.cols() : 0) {}
+
+        template <class Body>
+        void read(int r, Body body)
+        {
+            switch (m_.width())
+            {
+            case ElementWidth::Int32:
+                body(m_.row<int32_t>(r));
+                break;
+            case ElementWidth::UInt8:
+                body(m_.row<uint8_t>(r));
+                break;
+            default:
+                m_.unpack_row(r, 0, m_.cols(), buffer_.data());
+                body(static_cast<const uint8_t *>(buffer_.data()));
+                break;
+            }
+        }
+
+    private:
+        const Matrix &m_;
+        std::vector<uint8_t> buffer_;
+    };
+
+    bool window_equals(const Matrix &S, const Matrix &T, int i, int j)
+    {
+        for (int k = 0; k < S.rows(); ++k)
+        {
+            for (int l = 0; l < S.cols(); ++l)
+            {
+                if (T.at(i + k, j + l) != S.at(k, l))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+void compute_exact(const Matrix &S, const Matrix &T, std::vector<std::pair<int, int>> &positions,
+                   int threads_count, ThreadPool *pool, ExactStats *stats)
+{
+    validate_dimensions(S, T);
+    const int S_rows = S.rows(), S_cols = S.cols();
+    const int T_cols = T.cols();
+    const int max_i = T.rows() - S_rows + 1;
+    const int max_j = T_cols - S_cols + 1;
+    const uint64_t row_top = power(row_base, S_rows - 1); // weight of a column's top pixel
+    const uint64_t col_left = power(col_base, S_cols - 1); // weight of a window's left column
+
+    // Template hash, built the same way as the windows'
+    uint64_t S_hash = 0;
+    {
+        std::vector<uint64_t> column(S_cols, 0);
+        RowReader reader(S);
+        for (int k = 0; k < S_rows; ++k)
+        {
+            reader.read(k, [&](auto row)
+                        {
+                            for (int l = 0; l < S_cols; ++l)
+                            {
+                                column[l] = column[l] * row_base + static_cast<uint64_t>(row[l]);
+                            } });
+        }
+        for (int l = 0; l < S_cols; ++l)
+        {
+            S_hash = S_hash * col_base + column[l];
+        }
+    }
+
+    size_t num_threads = resolve_thread_count(threads_count, max_i, pool);
+    std::vector<std::vector<std::pair<int, int>>> band_positions(num_threads);
+    std::vector<ExactStats> band_stats(num_threads);
+    parallel_ranges(
+        max_i, num_threads,
+        [&](int thread, int start_i, int end_i)
+        {
+            if (start_i >= end_i)
+            {
+                return;
+            }
+            RowReader reader(T), outgoing(T);
+            std::vector<uint64_t> column(T_cols, 0);
+            // 初始化本區段第一列的欄雜湊
+            for (int k = 0; k < S_rows; ++k)
+            {
+                reader.read(start_i + k, [&](auto row)
+                            {
+                                for (int c = 0; c < T_cols; ++c)
+                                {
+                                    column[c] = column[c] * row_base + static_cast<uint64_t>(row[c]);
+                                } });
+            }
+
+            for (int i = start_i; i < end_i; ++i)
+            {
+                uint64_t hash = 0;
+                for (int l = 0; l < S_cols; ++l)
+                {
+                    hash = hash * col_base + column[l];
+                }
+                for (int j = 0; j < max_j; ++j)
+                {
+                    if (hash == S_hash)
+                    {
+                        band_stats[thread].hash_hits++;
+                        if (window_equals(S, T, i, j))
+                        {
+                            band_positions[thread].push_back({i, j});
+                        }
+                    }
+                    if (j + 1 < max_j)
+                    {
+                        hash = (hash - column[j] * col_left) * col_base + column[j + S_cols];
+                    }
+                }
+
+                // 欄雜湊往下滾一列
+                if (i + 1 < end_i)
+                {
+                    outgoing.read(i, [&](auto top)
+                                  { reader.read(i + S_rows, [&](auto bottom)
+                                                {
+                                                    for (int c = 0; c < T_cols; ++c)
+                                                    {
+                                                        column[c] = (column[c] - static_cast<uint64_t>(top[c]) * row_top) * row_base +
+                                                                    static_cast<uint64_t>(bottom[c]);
+                                                    } }); });
+                }
+            }
+        },
+        pool);
+
+    // 合併結果（區段依序排列，已是列優先順序）
+    positions.clear();
+    ExactStats total;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        positions.insert(positions.end(), band_positions[t].begin(), band_positions[t].end());
+        total.hash_hits += band_stats[t].hash_hits;
+    }
+    total.matches = positions.size();
+    if (stats)
+    {
+        *stats = total;
+    }
+}
@@ -0,0 +1,99 @@
+#include "fft.hpp"
+#include <cmath>
+#include <stdexcept>
+
+int next_pow2(int n)
+{
+    int p = 1;
+    while (p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+FFTPlan::FFTPlan(int size) : n(size), bit_reverse(size), twiddle(size / 2)
+{
+    if (size <= 0 || (size & (size - 1)) != 0)
+    {
+        throw std::invalid_argument("FFT size must be a power of two");
+    }
+    int bits = 0;
+    while ((1 << bits) < size)
+    {
+        ++bits;
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; ++b)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse[i] = r;
+    }
+    const double pi = std::acos(-1.0);
+    for (int k = 0; k < size / 2; ++k)
+    {
+        twiddle[k] = std::polar(1.0, -2.0 * pi * k / size);
+    }
+}
+
+void FFTPlan::transform(std::complex<double> *data, bool inverse) const
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (i < bit_reverse[i])
+        {
+            std::swap(data[i], data[bit_reverse[i]]);
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        int half = len / 2;
+        int step = n / len;
+        for (int start = 0; start < n; start += len)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                std::complex<double> w = inverse ? std::conj(twiddle[k * step]) : twiddle[k * step];
+                std::complex<double> u = data[start + k];
+                std::complex<double> v = data[start + k + half] * w;
+                data[start + k] = u + v;
+                data[start + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void fft_2d(std::vector<std::complex<double>> &data, const FFTPlan &row_plan, const FFTPlan &col_plan,
+            bool inverse)
+{
+    int rows = col_plan.n;
+    int cols = row_plan.n;
+    for (int r = 0; r < rows; ++r)
+    {
+        row_plan.transform(data.data() + static_cast<size_t>(r) * cols, inverse);
+    }
+    std::vector<std::complex<double>> column(rows);
+    for (int c = 0; c < cols; ++c)
+    {
+        for (int r = 0; r < rows; ++r)
+        {
+            column[r] = data[static_cast<size_t>(r) * cols + c];
+        }
+        col_plan.transform(column.data(), inverse);
+        for (int r = 0; r < rows; ++r)
+        {
+            data[static_cast<size_t>(r) * cols + c] = column[r];
+        }
+    }
+    if (inverse)
+    {
+        double scale = 1.0 / (static_cast<double>(rows) * cols);
+        for (auto &v : data)
+        {
+            v *= scale;
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#include "fft.hpp"
+#include "pcc.hpp"
+#include "ssd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+struct FFTThreadData
+{
+    const Matrix *T; // any width, read in place
+    const std::vector<std::complex<double>> *kernel; // conj(FFT(S)) on the tile grid
+    const FFTPlan *row_plan;
+    const FFTPlan *col_plan;
+    std::atomic<int> *next_tile;
+    int S_rows, S_cols, T_rows, T_cols;
+    int tile_rows, tile_cols, tiles_x, tiles_count;
+    Metric metric;
+    long long sum_S, sum_sq_S;
+    double local_best_value;
+    std::vector<std::pair<int, int>> local_best_positions;
+};
+
+static void *fft_thread_func(void *arg)
+{
+    FFTThreadData *data = (FFTThreadData *)arg;
+    bool find_max = metric_find_max(data->metric);
+    long long n = static_cast<long long>(data->S_rows) * data->S_cols;
+    data->local_best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    data->local_best_positions.clear();
+
+    int max_i = data->T_rows - data->S_rows + 1;
+    int max_j = data->T_cols - data->S_cols + 1;
+    int valid_rows = data->tile_rows - data->S_rows + 1;
+    int valid_cols = data->tile_cols - data->S_cols + 1;
+    std::vector<std::complex<double>> buffer(static_cast<size_t>(data->tile_rows) * data->tile_cols);
+    // Summed-area tables of the tile and its squares, (tile_rows + 1) x (tile_cols + 1)
+    const size_t sat_cols = data->tile_cols + 1;
+    std::vector<long long> sat(sat_cols * (data->tile_rows + 1)), sat_sq(sat.size());
+    std::vector<uint8_t> pixels(data->tile_cols);
+
+    for (int tile = data->next_tile->fetch_add(1); tile < data->tiles_count; tile = data->next_tile->fetch_add(1))
+    {
+        int i0 = (tile / data->tiles_x) * valid_rows;
+        int j0 = (tile % data->tiles_x) * valid_cols;
+
+        // Load the tile (zero-padded past the edge of T) and its window-sum tables
+        for (int r = 0; r < data->tile_rows; ++r)
+        {
+            std::fill(pixels.begin(), pixels.end(), 0);
+            if (i0 + r < data->T_rows)
+            {
+                data->T->unpack_row(i0 + r, j0, std::min(data->tile_cols, data->T_cols - j0), pixels.data());
+            }
+            std::complex<double> *dst = buffer.data() + static_cast<size_t>(r) * data->tile_cols;
+            const long long *above = sat.data() + r * sat_cols, *above_sq = sat_sq.data() + r * sat_cols;
+            long long *out = sat.data() + (r + 1) * sat_cols, *out_sq = sat_sq.data() + (r + 1) * sat_cols;
+            long long row_sum = 0, row_sum_sq = 0;
+            for (int c = 0; c < data->tile_cols; ++c)
+            {
+                int v = pixels[c];
+                dst[c] = v;
+                row_sum += v;
+                row_sum_sq += v * v;
+                out[c + 1] = above[c + 1] + row_sum;
+                out_sq[c + 1] = above_sq[c + 1] + row_sum_sq;
+            }
+        }
+        auto window_sum = [&](const std::vector<long long> &table, int a, int b)
+        {
+            const long long *top = table.data() + a * sat_cols, *bottom = top + data->S_rows * sat_cols;
+            return bottom[b + data->S_cols] - top[b + data->S_cols] - bottom[b] + top[b];
+        };
+
+        fft_2d(buffer, *data->row_plan, *data->col_plan, false);
+        for (size_t k = 0; k < buffer.size(); ++k)
+        {
+            buffer[k] *= (*data->kernel)[k];
+        }
+        fft_2d(buffer, *data->row_plan, *data->col_plan, true);
+
+        // Overlap-save: keep only the outputs that did not wrap around
+        int end_i = std::min(i0 + valid_rows, max_i);
+        int end_j = std::min(j0 + valid_cols, max_j);
+        for (int i = i0; i < end_i; ++i)
+        {
+            for (int j = j0; j < end_j; ++j)
+            {
+                long long sum_ST = std::llround(buffer[static_cast<size_t>(i - i0) * data->tile_cols + (j - j0)].real());
+                long long sum_sq_T = window_sum(sat_sq, i - i0, j - j0);
+                double value;
+                if (data->metric == Metric::PCC)
+                {
+                    long long sum_T = window_sum(sat, i - i0, j - j0);
+                    value = pcc_from_sums(n, sum_T, data->sum_S, sum_sq_T, data->sum_sq_S, sum_ST);
+                }
+                else
+                {
+                    value = ssd_from_sums(sum_sq_T, data->sum_sq_S, sum_ST);
+                }
+                update_best(value, i, j, find_max, data->local_best_value, data->local_best_positions);
+            }
+        }
+    }
+    return nullptr;
+}
+
+void compute_fft(const Matrix &S_matrix, const Matrix &T_matrix, Metric metric,
+                 std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                 ThreadPool *pool)
+{
+    validate_dimensions(S_matrix, T_matrix);
+    require_pcc_or_ssd(metric, "fft");
+    int S_rows = S_matrix.rows(), S_cols = S_matrix.cols();
+    int T_rows = T_matrix.rows(), T_cols = T_matrix.cols();
+    std::vector<int> S = S_matrix.to_vector();
+
+    bool find_max = metric_find_max(metric);
+    best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    best_positions.clear();
+
+    long long sum_S = 0, sum_sq_S = 0;
+    for (int v : S)
+    {
+        sum_S += v;
+        sum_sq_S += v * v;
+    }
+
+    // Tile edge about 4x the template (at least 64) keeps most of each tile valid
+    // while bounding per-thread memory; never larger than T itself needs
+    int tile_rows = std::min(std::max(64, next_pow2(4 * S_rows)), next_pow2(T_rows));
+    int tile_cols = std::min(std::max(64, next_pow2(4 * S_cols)), next_pow2(T_cols));
+    FFTPlan row_plan(tile_cols);
+    FFTPlan col_plan(tile_rows);
+
+    // 模板的頻域核心，所有 tile 共用
+    std::vector<std::complex<double>> kernel(static_cast<size_t>(tile_rows) * tile_cols);
+    for (int k = 0; k < S_rows; ++k)
+    {
+        for (int l = 0; l < S_cols; ++l)
+        {
+            kernel[static_cast<size_t>(k) * tile_cols + l] = S[k * S_cols + l];
+        }
+    }
+    fft_2d(kernel, row_plan, col_plan, false);
+    for (auto &v : kernel)
+    {
+        v = std::conj(v);
+    }
+
+    int max_i = T_rows - S_rows + 1;
+    int max_j = T_cols - S_cols + 1;
+    int tiles_y = (max_i + tile_rows - S_rows) / (tile_rows - S_rows + 1);
+    int tiles_x = (max_j + tile_cols - S_cols) / (tile_cols - S_cols + 1);
+    int tiles_count = tiles_x * tiles_y;
+
+    std::atomic<int> next_tile(0);
+    size_t num_threads = resolve_thread_count(threads_count, tiles_count, pool);
+    std::vector<FFTThreadData> thread_data(num_threads);
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        thread_data[t].T = &T_matrix;
+        thread_data[t].kernel = &kernel;
+        thread_data[t].row_plan = &row_plan;
+        thread_data[t].col_plan = &col_plan;
+        thread_data[t].next_tile = &next_tile;
+        thread_data[t].S_rows = S_rows;
+        thread_data[t].S_cols = S_cols;
+        thread_data[t].T_rows = T_rows;
+        thread_data[t].T_cols = T_cols;
+        thread_data[t].tile_rows = tile_rows;
+        thread_data[t].tile_cols = tile_cols;
+        thread_data[t].tiles_x = tiles_x;
+        thread_data[t].tiles_count = tiles_count;
+        thread_data[t].metric = metric;
+        thread_data[t].sum_S = sum_S;
+        thread_data[t].sum_sq_S = sum_sq_S;
+    }
+
+    // One task per worker; each claims tiles from the shared counter
+    parallel_ranges(
+        num_threads, num_threads,
+        [&](int t, int, int)
+        {
+            fft_thread_func(&thread_data[t]);
+        },
+        pool);
+
+    // 合併結果
+    for (const auto &data : thread_data)
+    {
+        merge_best(data.local_best_value, data.local_best_positions, find_max, best_value, best_positions);
+    }
+    // Tiles finish out of order; report positions row-major like compute()
+    std::sort(best_positions.begin(), best_positions.end());
+}
@@ -0,0 +1,138 @@
+#include "fused.hpp"
+#include "kernel.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+const MetricResult &MultiMetricResult::operator[](Metric metric) const
+{
+    for (const auto &result : results)
+    {
+        if (result.metric == metric)
+        {
+            return result;
+        }
+    }
+    throw std::out_of_range(std::string("Metric was not computed: ") + metric_name(metric));
+}
+
+namespace
+{
+    struct FusedContext
+    {
+        const int *S;
+        int S_rows, S_cols;
+        long long sum_Y, sum_YY; // template sums, fixed for every window
+        std::vector<Metric> metrics;
+    };
+
+    // Score one tile of positions. `window` points at the tile's top-left pixel;
+    // locals[k] tracks ctx.metrics[k].
+    template <int R, int C, bool WithSAD, class Pixel>
+    void fused_tile(const FusedContext &ctx, const Pixel *window, size_t stride, const Tile &tile,
+                    std::vector<LocalBest> &locals)
+    {
+        const int n = ctx.S_rows * ctx.S_cols;
+        scan_tile<WindowSums<true, WithSAD>, R, C>(
+            window, stride, ctx.S, ctx.S_rows, ctx.S_cols, tile.i0, tile.i1, tile.j0, tile.j1,
+            [&](const WindowSums<true, WithSAD> &sums, int i, int j)
+            {
+                for (size_t m = 0; m < ctx.metrics.size(); ++m)
+                {
+                    double value = sums.score(ctx.metrics[m], n, ctx.sum_Y, ctx.sum_YY);
+                    update_best(value, i, j, metric_find_max(ctx.metrics[m]), locals[m].value, locals[m].positions);
+                }
+            });
+    }
+
+    template <class Pixel>
+    using FusedTileFunc = void (*)(const FusedContext &, const Pixel *, size_t, const Tile &, std::vector<LocalBest> &);
+
+    template <class Pixel>
+    FusedTileFunc<Pixel> select_fused(int S_rows, int S_cols, bool with_sad)
+    {
+        return dispatch_shape(S_rows, S_cols, [with_sad](auto R, auto C)
+                              { return with_sad ? fused_tile<R, C, true, Pixel> : fused_tile<R, C, false, Pixel>; });
+    }
+}
+
+void compute_fused(const Matrix &S, const Matrix &T, const std::vector<Metric> &metrics,
+                   MultiMetricResult &result, int threads_count, ThreadPool *pool, SchedulerStats *stats)
+{
+    validate_dimensions(S, T);
+    if (metrics.empty())
+    {
+        throw std::invalid_argument("Fused pass needs at least one metric");
+    }
+
+    std::vector<int> S_values = S.to_vector();
+    FusedContext ctx;
+    ctx.S = S_values.data();
+    ctx.S_rows = S.rows();
+    ctx.S_cols = S.cols();
+    ctx.sum_Y = 0;
+    ctx.sum_YY = 0;
+    for (int y : S_values)
+    {
+        ctx.sum_Y += y;
+        ctx.sum_YY += static_cast<long long>(y) * y;
+    }
+    ctx.metrics = metrics;
+    bool with_sad = std::find(metrics.begin(), metrics.end(), Metric::SAD) != metrics.end();
+
+    const int max_i = T.rows() - S.rows() + 1;
+    const int max_j = T.cols() - S.cols() + 1;
+    int num_workers = resolve_thread_count(threads_count, max_i * max_j, pool);
+    std::vector<Tile> tiles = make_tiles(max_i, max_j, S.rows(), S.cols(), T.width(), num_workers);
+
+    std::vector<LocalBest> reset;
+    for (Metric metric : metrics)
+    {
+        reset.push_back({metric_find_max(metric) ? -std::numeric_limits<double>::max()
+                                                 : std::numeric_limits<double>::max(),
+                         {}});
+    }
+    std::vector<std::vector<LocalBest>> locals(num_workers, reset);
+
+    auto int_tile = select_fused<int32_t>(S.rows(), S.cols(), with_sad);
+    auto byte_tile = select_fused<uint8_t>(S.rows(), S.cols(), with_sad);
+    // Nibble tiles are unpacked into a per-worker byte buffer first
+    std::vector<std::vector<uint8_t>> unpacked(num_workers);
+    run_tiles(
+        tiles, num_workers,
+        [&](int worker, const Tile &tile)
+        {
+            switch (T.width())
+            {
+            case ElementWidth::Int32:
+                int_tile(ctx, T.row<int32_t>(tile.i0) + tile.j0, T.stride() / sizeof(int32_t), tile, locals[worker]);
+                break;
+            case ElementWidth::UInt8:
+                byte_tile(ctx, T.row<uint8_t>(tile.i0) + tile.j0, T.stride(), tile, locals[worker]);
+                break;
+            default:
+            {
+                int cols = tile.j1 - tile.j0 + S.cols() - 1;
+                unpack_tile(T, tile.i0, tile.j0, tile.i1 - tile.i0 + S.rows() - 1, cols, unpacked[worker]);
+                byte_tile(ctx, unpacked[worker].data(), cols, tile, locals[worker]);
+                break;
+            }
+            }
+        },
+        stats, pool);
+
+    // 合併結果
+    result.results.clear();
+    for (size_t m = 0; m < metrics.size(); ++m)
+    {
+        bool find_max = metric_find_max(metrics[m]);
+        MetricResult merged{metrics[m], reset[m].value, {}};
+        for (const auto &worker_locals : locals)
+        {
+            merge_best(worker_locals[m].value, worker_locals[m].positions, find_max, merged.best_value,
+                       merged.best_positions);
+        }
+        std::sort(merged.best_positions.begin(), merged.best_positions.end());
+        result.results.push_back(std::move(merged));
+    }
+}
@@ -0,0 +1,275 @@
+#include "incremental.hpp"
+#include "kernel.hpp"
+#include <cstdint>
+#include <stdexcept>
+
+namespace
+{
+    // Score windows (i, j0) .. (i, j1 - 1); `window` points at T(i, j0)
+    template <class MetricKernel, class Pixel>
+    void score_span(const Pixel *window, size_t stride, const int *S, int rows, int cols, int count, double *out)
+    {
+        for (int j = 0; j < count; ++j)
+        {
+            out[j] = window_score<MetricKernel, 0, 0, Pixel>(window + j, stride, S, rows, cols);
+        }
+    }
+
+    template <class Pixel>
+    void score_span(Metric metric, const Pixel *window, size_t stride, const int *S, int rows, int cols, int count,
+                    double *out)
+    {
+        switch (metric)
+        {
+        case Metric::PCC:
+            score_span<PCCKernel>(window, stride, S, rows, cols, count, out);
+            break;
+        case Metric::SSD:
+            score_span<SSDKernel>(window, stride, S, rows, cols, count, out);
+            break;
+        case Metric::SAD:
+            score_span<SADKernel>(window, stride, S, rows, cols, count, out);
+            break;
+        default:
+            score_span<NCCKernel>(window, stride, S, rows, cols, count, out);
+            break;
+        }
+    }
+
+    // Window positions whose window overlaps `rect`, clipped to the output space
+    DirtyRect affected_windows(const DirtyRect &rect, int S_rows, int S_cols, int max_i, int max_j)
+    {
+        return {std::max(rect.r0 - S_rows + 1, 0), std::min(rect.r1, max_i), std::max(rect.c0 - S_cols + 1, 0),
+                std::min(rect.c1, max_j)};
+    }
+}
+
+IncrementalMatch::IncrementalMatch(const Matrix &S, Metric metric)
+    : metric_(metric), find_max_(metric_find_max(metric)), S_rows_(S.rows()), S_cols_(S.cols()),
+      S_values_(S.to_vector())
+{
+}
+
+void IncrementalMatch::reset(const Matrix &T, int threads_count, ThreadPool *pool)
+{
+    if (S_rows_ <= 0 || S_cols_ <= 0 || T.rows() < S_rows_ || T.cols() < S_cols_)
+    {
+        throw std::invalid_argument("Matrix dimensions are invalid");
+    }
+    T_rows_ = T.rows();
+    T_cols_ = T.cols();
+    max_i_ = T_rows_ - S_rows_ + 1;
+    max_j_ = T_cols_ - S_cols_ + 1;
+    blocks_i_ = (max_i_ + block_size - 1) / block_size;
+    blocks_j_ = (max_j_ + block_size - 1) / block_size;
+    scores_.assign(static_cast<size_t>(max_i_) * max_j_, 0.0);
+    summaries_.assign(static_cast<size_t>(blocks_i_) * blocks_j_, LocalBest());
+
+    std::vector<Span> spans(max_i_);
+    for (int i = 0; i < max_i_; ++i)
+    {
+        spans[i] = {i, 0, max_j_};
+    }
+    rescore(T, spans, threads_count, pool);
+    std::vector<int> blocks(summaries_.size());
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        blocks[b] = static_cast<int>(b);
+    }
+    summarise(blocks, threads_count, pool);
+    reduce();
+}
+
+void IncrementalMatch::update(const Matrix &T, const std::vector<DirtyRect> &dirty, int threads_count,
+                              ThreadPool *pool, IncrementalStats *stats)
+{
+    if (scores_.empty())
+    {
+        throw std::logic_error("IncrementalMatch::update called before reset");
+    }
+    if (T.rows() != T_rows_ || T.cols() != T_cols_)
+    {
+        throw std::invalid_argument("IncrementalMatch::update: T changed shape, call reset");
+    }
+
+    // 每列輸出合併重疊的區間，同一位置只算一次
+    std::vector<std::vector<std::pair<int, int>>> intervals(max_i_);
+    std::vector<char> touched(summaries_.size(), 0);
+    for (const DirtyRect &rect : dirty)
+    {
+        if (rect.r0 > rect.r1 || rect.c0 > rect.c1)
+        {
+            throw std::invalid_argument("Dirty rectangle has negative size");
+        }
+        DirtyRect windows = affected_windows(rect, S_rows_, S_cols_, max_i_, max_j_);
+        if (windows.r0 >= windows.r1 || windows.c0 >= windows.c1)
+        {
+            continue;
+        }
+        for (int i = windows.r0; i < windows.r1; ++i)
+        {
+            intervals[i].push_back({windows.c0, windows.c1});
+        }
+        for (int bi = windows.r0 / block_size; bi <= (windows.r1 - 1) / block_size; ++bi)
+        {
+            for (int bj = windows.c0 / block_size; bj <= (windows.c1 - 1) / block_size; ++bj)
+            {
+                touched[static_cast<size_t>(bi) * blocks_j_ + bj] = 1;
+            }
+        }
+    }
+    std::vector<Span> spans;
+    long long rescored = 0;
+    for (int i = 0; i < max_i_; ++i)
+    {
+        auto &row = intervals[i];
+        std::sort(row.begin(), row.end());
+        for (size_t k = 0; k < row.size();)
+        {
+            int j0 = row[k].first, j1 = row[k].second;
+            for (++k; k < row.size() && row[k].first <= j1; ++k)
+            {
+                j1 = std::max(j1, row[k].second);
+            }
+            spans.push_back({i, j0, j1});
+            rescored += j1 - j0;
+        }
+    }
+    std::vector<int> blocks;
+    for (size_t b = 0; b < touched.size(); ++b)
+    {
+        if (touched[b])
+        {
+            blocks.push_back(static_cast<int>(b));
+        }
+    }
+
+    rescore(T, spans, threads_count, pool);
+    summarise(blocks, threads_count, pool);
+    if (!blocks.empty())
+    {
+        reduce();
+    }
+    if (stats)
+    {
+        stats->rescored = rescored;
+        stats->blocks = static_cast<int>(blocks.size());
+        stats->blocks_total = static_cast<int>(summaries_.size());
+    }
+}
+
+void IncrementalMatch::rescore(const Matrix &T, const std::vector<Span> &spans, int threads_count,
+                               ThreadPool *pool)
+{
+    if (spans.empty())
+    {
+        return;
+    }
+    // Spans are disjoint, so workers write separate parts of the score map
+    parallel_ranges(
+        static_cast<int>(spans.size()), threads_count,
+        [&](int, int begin, int end)
+        {
+            std::vector<uint8_t> strip; // nibble rows unpacked for one span
+            for (int s = begin; s < end; ++s)
+            {
+                const Span &span = spans[s];
+                double *out = scores_.data() + static_cast<size_t>(span.i) * max_j_ + span.j0;
+                const int count = span.j1 - span.j0;
+                switch (T.width())
+                {
+                case ElementWidth::Int32:
+                    score_span(metric_, T.row<int32_t>(span.i) + span.j0, T.stride() / sizeof(int32_t),
+                               S_values_.data(), S_rows_, S_cols_, count, out);
+                    break;
+                case ElementWidth::UInt8:
+                    score_span(metric_, T.row<uint8_t>(span.i) + span.j0, T.stride(), S_values_.data(), S_rows_,
+                               S_cols_, count, out);
+                    break;
+                default:
+                {
+                    const int width = count + S_cols_ - 1;
+                    strip.resize(static_cast<size_t>(S_rows_) * width);
+                    for (int k = 0; k < S_rows_; ++k)
+                    {
+                        T.unpack_row(span.i + k, span.j0, width, strip.data() + static_cast<size_t>(k) * width);
+                    }
+                    score_span(metric_, strip.data(), width, S_values_.data(), S_rows_, S_cols_, count, out);
+                    break;
+                }
+                }
+            }
+        },
+        pool);
+}
+
+void IncrementalMatch::summarise(const std::vector<int> &blocks, int threads_count, ThreadPool *pool)
+{
+    if (blocks.empty())
+    {
+        return;
+    }
+    const double reset = find_max_ ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    parallel_ranges(
+        static_cast<int>(blocks.size()), threads_count,
+        [&](int, int begin, int end)
+        {
+            for (int k = begin; k < end; ++k)
+            {
+                const int b = blocks[k];
+                const int i0 = b / blocks_j_ * block_size, j0 = b % blocks_j_ * block_size;
+                LocalBest &summary = summaries_[b];
+                summary.value = reset;
+                summary.positions.clear();
+                for (int i = i0; i < std::min(i0 + block_size, max_i_); ++i)
+                {
+                    const double *row = scores_.data() + static_cast<size_t>(i) * max_j_;
+                    for (int j = j0; j < std::min(j0 + block_size, max_j_); ++j)
+                    {
+                        update_best(row[j], i, j, find_max_, summary.value, summary.positions);
+                    }
+                }
+            }
+        },
+        pool);
+}
+
+std::vector<DirtyRect> diff_frames(const Matrix &before, const Matrix &after)
+{
+    if (before.rows() != after.rows() || before.cols() != after.cols())
+    {
+        throw std::invalid_argument("Frames must have the same dimensions");
+    }
+    std::vector<DirtyRect> dirty;
+    std::vector<uint8_t> a(before.cols()), b(after.cols());
+    for (int r = 0; r < before.rows(); ++r)
+    {
+        before.unpack_row(r, 0, before.cols(), a.data());
+        after.unpack_row(r, 0, after.cols(), b.data());
+        int c0 = 0, c1 = before.cols();
+        while (c0 < c1 && a[c0] == b[c0])
+        {
+            ++c0;
+        }
+        while (c1 > c0 && a[c1 - 1] == b[c1 - 1])
+        {
+            --c1;
+        }
+        if (c0 < c1)
+        {
+            dirty.push_back({r, r + 1, c0, c1});
+        }
+    }
+    return dirty;
+}
+
+void IncrementalMatch::reduce()
+{
+    best_value_ = find_max_ ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    best_positions_.clear();
+    for (const LocalBest &summary : summaries_)
+    {
+        merge_best(summary.value, summary.positions, find_max_, best_value_, best_positions_);
+    }
+    std::sort(best_positions_.begin(), best_positions_.end());
+}
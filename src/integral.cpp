@@ -0,0 +1,204 @@
+#include "integral.hpp"
+#include "pcc.hpp"
+#include "ssd.hpp"
+#include <stdexcept>
+
+struct IntegralBuildData
+{
+    const Matrix *T;
+    IntegralImage *image;
+    int begin, end; // row range in pass 1, column range in pass 2
+};
+
+// Pass 1: prefix sums along each row
+static void *integral_row_func(void *arg)
+{
+    IntegralBuildData *data = (IntegralBuildData *)arg;
+    IntegralImage &image = *data->image;
+    size_t stride = image.cols + 1;
+    std::vector<uint8_t> src(image.cols);
+    for (int r = data->begin; r < data->end; ++r)
+    {
+        uint32_t run = 0, run_sq = 0;
+        data->T->unpack_row(r, 0, image.cols, src.data());
+        uint32_t *dst = image.sum.data() + (r + 1) * stride;
+        uint32_t *dst_sq = image.sum_sq.data() + (r + 1) * stride;
+        for (int c = 0; c < image.cols; ++c)
+        {
+            uint32_t v = static_cast<uint32_t>(src[c]);
+            run += v;
+            run_sq += v * v;
+            dst[c + 1] = run;
+            dst_sq[c + 1] = run_sq;
+        }
+    }
+    return nullptr;
+}
+
+// Pass 2: accumulate rows downwards, one column band per thread
+static void *integral_col_func(void *arg)
+{
+    IntegralBuildData *data = (IntegralBuildData *)arg;
+    IntegralImage &image = *data->image;
+    size_t stride = image.cols + 1;
+    for (int r = 1; r <= image.rows; ++r)
+    {
+        uint32_t *cur = image.sum.data() + r * stride;
+        uint32_t *cur_sq = image.sum_sq.data() + r * stride;
+        const uint32_t *prev = cur - stride;
+        const uint32_t *prev_sq = cur_sq - stride;
+        for (int c = data->begin; c < data->end; ++c)
+        {
+            cur[c] += prev[c];
+            cur_sq[c] += prev_sq[c];
+        }
+    }
+    return nullptr;
+}
+
+static void run_integral_pass(void *(*func)(void *), const Matrix &T, IntegralImage &image,
+                              int first, int last, int threads_count, ThreadPool *pool)
+{
+    parallel_ranges(
+        last - first, threads_count,
+        [&](int, int begin, int end)
+        {
+            IntegralBuildData data;
+            data.T = &T;
+            data.image = &image;
+            data.begin = first + begin;
+            data.end = first + end;
+            func(&data);
+        },
+        pool);
+}
+
+void build_integral_image(const Matrix &T, IntegralImage &image, int threads_count, ThreadPool *pool)
+{
+    int T_rows = T.rows();
+    int T_cols = T.cols();
+    image.rows = T_rows;
+    image.cols = T_cols;
+    size_t size = static_cast<size_t>(T_rows + 1) * (T_cols + 1);
+    image.sum.assign(size, 0);
+    image.sum_sq.assign(size, 0);
+
+    run_integral_pass(integral_row_func, T, image, 0, T_rows, threads_count, pool);
+    run_integral_pass(integral_col_func, T, image, 1, T_cols + 1, threads_count, pool);
+}
+
+struct IntegralThreadData
+{
+    const std::vector<int> *S;
+    const Matrix *T; // uint8
+    const IntegralImage *image;
+    int S_rows, S_cols, T_rows, T_cols;
+    Metric metric;
+    long long sum_S, sum_sq_S;
+    int start_i, end_i;
+    double local_best_value;
+    std::vector<std::pair<int, int>> local_best_positions;
+};
+
+static void *integral_thread_func(void *arg)
+{
+    IntegralThreadData *data = (IntegralThreadData *)arg;
+    bool find_max = metric_find_max(data->metric);
+    long long n = static_cast<long long>(data->S_rows) * data->S_cols;
+    data->local_best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    data->local_best_positions.clear();
+
+    const int *S = data->S->data();
+    for (int i = data->start_i; i < data->end_i; ++i)
+    {
+        for (int j = 0; j <= data->T_cols - data->S_cols; ++j)
+        {
+            // Only the cross term needs the full window
+            long long sum_ST = 0;
+            for (int k = 0; k < data->S_rows; ++k)
+            {
+                const uint8_t *t_row = data->T->row<uint8_t>(i + k) + j;
+                const int *s_row = S + k * data->S_cols;
+                int row_sum = 0;
+                for (int l = 0; l < data->S_cols; ++l)
+                {
+                    row_sum += t_row[l] * s_row[l];
+                }
+                sum_ST += row_sum;
+            }
+            long long sum_sq_T = data->image->window_sum_sq(i, j, data->S_rows, data->S_cols);
+            double value;
+            if (data->metric == Metric::PCC)
+            {
+                long long sum_T = data->image->window_sum(i, j, data->S_rows, data->S_cols);
+                value = pcc_from_sums(n, sum_T, data->sum_S, sum_sq_T, data->sum_sq_S, sum_ST);
+            }
+            else
+            {
+                value = ssd_from_sums(sum_sq_T, data->sum_sq_S, sum_ST);
+            }
+            update_best(value, i, j, find_max, data->local_best_value, data->local_best_positions);
+        }
+    }
+    return nullptr;
+}
+
+void compute_integral(const Matrix &S_matrix, const Matrix &T_matrix, Metric metric,
+                      std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                      ThreadPool *pool)
+{
+    validate_dimensions(S_matrix, T_matrix);
+    require_pcc_or_ssd(metric, "integral");
+    int S_rows = S_matrix.rows(), S_cols = S_matrix.cols();
+    int T_rows = T_matrix.rows(), T_cols = T_matrix.cols();
+    std::vector<int> S = S_matrix.to_vector();
+    Matrix T = T_matrix.as_width(ElementWidth::UInt8);
+
+    bool find_max = metric_find_max(metric);
+    best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    best_positions.clear();
+
+    IntegralImage image;
+    build_integral_image(T, image, threads_count, pool);
+
+    long long sum_S = 0, sum_sq_S = 0;
+    for (int v : S)
+    {
+        sum_S += v;
+        sum_sq_S += v * v;
+    }
+
+    int max_i = T_rows - S_rows + 1;
+    size_t num_threads = resolve_thread_count(threads_count, max_i, pool);
+    std::vector<IntegralThreadData> thread_data(num_threads);
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        thread_data[t].S = &S;
+        thread_data[t].T = &T;
+        thread_data[t].image = &image;
+        thread_data[t].S_rows = S_rows;
+        thread_data[t].S_cols = S_cols;
+        thread_data[t].T_rows = T_rows;
+        thread_data[t].T_cols = T_cols;
+        thread_data[t].metric = metric;
+        thread_data[t].sum_S = sum_S;
+        thread_data[t].sum_sq_S = sum_sq_S;
+    }
+
+    // 拆分任務
+    parallel_ranges(
+        max_i, num_threads,
+        [&](int t, int start_i, int end_i)
+        {
+            thread_data[t].start_i = start_i;
+            thread_data[t].end_i = end_i;
+            integral_thread_func(&thread_data[t]);
+        },
+        pool);
+
+    // 合併結果
+    for (const auto &data : thread_data)
+    {
+        merge_best(data.local_best_value, data.local_best_positions, find_max, best_value, best_positions);
+    }
+}
@@ -0,0 +1,43 @@
+#include "kernel.hpp"
+
+template <class MetricKernel, int R, int C, bool Collect>
+static ScanKernel select_collect(ElementWidth width)
+{
+    switch (width)
+    {
+    case ElementWidth::Int32:
+        return scan_band<MetricKernel, R, C, int32_t, Collect>;
+    case ElementWidth::UInt8:
+        return scan_band<MetricKernel, R, C, uint8_t, Collect>;
+    default:
+        return scan_band_nibble<MetricKernel, R, C, Collect>;
+    }
+}
+
+template <class MetricKernel, int R, int C>
+static ScanKernel select_width(ElementWidth width, bool collect)
+{
+    return collect ? select_collect<MetricKernel, R, C, true>(width) : select_collect<MetricKernel, R, C, false>(width);
+}
+
+template <class MetricKernel>
+static ScanKernel select_shape(int S_rows, int S_cols, ElementWidth width, bool collect)
+{
+    return dispatch_shape(S_rows, S_cols, [&](auto R, auto C)
+                          { return select_width<MetricKernel, R, C>(width, collect); });
+}
+
+ScanKernel select_kernel(Metric metric, int S_rows, int S_cols, ElementWidth width, bool collect)
+{
+    switch (metric)
+    {
+    case Metric::PCC:
+        return select_shape<PCCKernel>(S_rows, S_cols, width, collect);
+    case Metric::SAD:
+        return select_shape<SADKernel>(S_rows, S_cols, width, collect);
+    case Metric::NCC:
+        return select_shape<NCCKernel>(S_rows, S_cols, width, collect);
+    default:
+        return select_shape<SSDKernel>(S_rows, S_cols, width, collect);
+    }
+}
@@ -5,20 +5,227 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 
 #include "compute.hpp"
+#include "engine.hpp"
+#include "integral.hpp"
+#include "matcher.hpp"
+#include "batch.hpp"
+#include "branch_bound.hpp"
+#include "exact.hpp"
+#include "fft.hpp"
+#include "fused.hpp"
+#include "incremental.hpp"
+#include "simd.hpp"
 #include "pcc.hpp"
+#include "pipeline.hpp"
+#include "planner.hpp"
+#include "pyramid.hpp"
 #include "ssd.hpp"
+#include "stream.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
+#include "matfile.hpp"
+#include "scheduler.hpp"
+#include "server.hpp"
 
 struct Method
 {
     std::string name;
-    std::function<double(const std::vector<int> &, const std::vector<int> &)> compute_func;
-    bool find_max;
+    Metric metric;
 };
 
+struct Options
+{
+    Engine engine = Engine::Direct;
+    ElementWidth storage = ElementWidth::UInt8;
+    bool build_cache = false;
+    bool fused = false;
+    std::vector<Metric> metrics = {Metric::PCC, Metric::SSD};
+    ResultOptions results; // --top / --threshold / --nms
+    int band_rows = 0;     // stream engine: output rows per band, 0 = about 64 MB
+    bool pipeline = false; // score the first metric while T is still being parsed
+    std::string templates; // batch mode: folder of templates matched against T in one pass
+    std::string trace;     // Chrome-trace JSON of the direct engine's workers, "" = off
+    bool counters = false; // add hardware counters to the trace
+    Placement placement = Placement::None; // pool worker pinning, see topology.hpp
+    bool plan = false;                     // production: run the planned configuration once
+    PlannerOptions planner;                // --tuning-file / --retune
+    ServerOptions server;                  // --serve: daemon on this socket, "" = off
+    std::vector<std::string> scenes;       // --serve: folders whose T* files stay resident
+    std::string frames;                    // incremental mode: folder of later frames of T
+};
+
+// Usage: program [direct|integral|fft|simd|bnb|exact|pyramid|stream] [--storage int32|uint8|nibble] [--build-cache]
+//                [--metrics pcc,ssd,sad,ncc] [--fused] [--top K [--threshold X]] [--nms R]
+//                [--band-rows N] [--pipeline] [--templates DIR] [--trace FILE [--counters]]
+//                [--placement none|compact|scatter|physical|numa] [--plan [--tuning-file FILE] [--retune]]
+//                [--frames DIR]
+//        program --serve SOCKET --scenes DIR[,DIR...] [--batch-window US] [--storage ...] [--placement ...]
+Options parse_options(int argc, char *argv[])
+{
+    Options options;
+    for (int k = 1; k < argc; ++k)
+    {
+        std::string arg = argv[k];
+        if (arg == "--storage" && k + 1 < argc)
+        {
+            options.storage = parse_element_width(argv[++k]);
+        }
+        else if (arg == "--build-cache")
+        {
+            options.build_cache = true;
+        }
+        else if (arg == "--metrics" && k + 1 < argc)
+        {
+            options.metrics = parse_metrics(argv[++k]);
+        }
+        else if (arg == "--fused")
+        {
+            options.fused = true;
+        }
+        else if (arg == "--top" && k + 1 < argc)
+        {
+            options.results.k = std::stoi(argv[++k]);
+            if (options.results.mode == ResultMode::Best)
+            {
+                options.results.mode = ResultMode::TopK;
+            }
+        }
+        else if (arg == "--threshold" && k + 1 < argc)
+        {
+            options.results.mode = ResultMode::Threshold; // --top caps the count
+            options.results.threshold = std::stod(argv[++k]);
+        }
+        else if (arg == "--nms" && k + 1 < argc)
+        {
+            options.results.nms_radius = std::stoi(argv[++k]);
+        }
+        else if (arg == "--band-rows" && k + 1 < argc)
+        {
+            options.band_rows = std::stoi(argv[++k]);
+        }
+        else if (arg == "--pipeline")
+        {
+            options.pipeline = true;
+        }
+        else if (arg == "--trace" && k + 1 < argc)
+        {
+            options.trace = argv[++k];
+        }
+        else if (arg == "--counters")
+        {
+            options.counters = true;
+        }
+        else if (arg == "--placement" && k + 1 < argc)
+        {
+            options.placement = parse_placement(argv[++k]);
+        }
+        else if (arg == "--plan")
+        {
+            options.plan = true;
+        }
+        else if (arg == "--tuning-file" && k + 1 < argc)
+        {
+            options.planner.tuning_file = argv[++k];
+        }
+        else if (arg == "--retune")
+        {
+            options.planner.retune = true;
+        }
+        else if (arg == "--serve" && k + 1 < argc)
+        {
+            options.server.socket_path = argv[++k];
+        }
+        else if (arg == "--scenes" && k + 1 < argc)
+        {
+            std::stringstream ss(argv[++k]);
+            std::string folder;
+            while (std::getline(ss, folder, ','))
+            {
+                if (!folder.empty())
+                {
+                    options.scenes.push_back(folder);
+                }
+            }
+        }
+        else if (arg == "--batch-window" && k + 1 < argc)
+        {
+            options.server.batch_window_us = std::max(0, std::stoi(argv[++k]));
+        }
+        else if (arg == "--templates" && k + 1 < argc)
+        {
+            options.templates = argv[++k];
+        }
+        else if (arg == "--frames" && k + 1 < argc)
+        {
+            options.frames = argv[++k];
+        }
+        else
+        {
+            options.engine = parse_engine(arg);
+        }
+    }
+    if (options.results.mode == ResultMode::Threshold && options.results.k <= 0)
+    {
+        throw std::runtime_error("--threshold needs --top K to bound the number of results");
+    }
+    if (options.results.mode != ResultMode::Best && (options.engine != Engine::Direct || options.fused))
+    {
+        throw std::runtime_error("--top / --threshold are only available with the direct engine");
+    }
+    if (options.fused && options.engine == Engine::Stream)
+    {
+        throw std::runtime_error("--fused needs T in memory and cannot be combined with the stream engine");
+    }
+    if (options.pipeline && options.engine == Engine::Stream)
+    {
+        throw std::runtime_error("--pipeline loads T into memory and cannot be combined with the stream engine");
+    }
+    if (!options.templates.empty() && (options.engine != Engine::Direct || options.fused || options.pipeline ||
+                                       options.results.mode != ResultMode::Best))
+    {
+        throw std::runtime_error("--templates runs its own batched pass and takes no engine, --fused, --pipeline "
+                                 "or ranked result options");
+    }
+    if (options.counters && options.trace.empty())
+    {
+        throw std::runtime_error("--counters needs --trace FILE");
+    }
+    if (!options.trace.empty() && (options.engine != Engine::Direct || options.fused || !options.templates.empty()))
+    {
+        throw std::runtime_error("--trace instruments the direct engine only");
+    }
+    if (options.plan && (options.engine != Engine::Direct || options.fused || options.pipeline ||
+                         !options.templates.empty() || !options.trace.empty() ||
+                         options.results.mode != ResultMode::Best))
+    {
+        throw std::runtime_error("--plan chooses the engine itself and runs a plain best-match search");
+    }
+    if (!options.server.socket_path.empty() &&
+        (options.engine != Engine::Direct || options.fused || options.pipeline || !options.templates.empty() ||
+         !options.trace.empty() || options.plan || options.results.mode != ResultMode::Best))
+    {
+        throw std::runtime_error("--serve takes its engine and result options from each request");
+    }
+    if (!options.frames.empty() &&
+        (options.engine != Engine::Direct || options.fused || options.pipeline || !options.templates.empty() ||
+         !options.trace.empty() || options.plan || options.results.mode != ResultMode::Best))
+    {
+        throw std::runtime_error("--frames re-matches changed regions with the direct kernels and takes no other "
+                                 "engine or mode");
+    }
+    if (options.server.socket_path.empty() != options.scenes.empty())
+    {
+        throw std::runtime_error("--serve SOCKET and --scenes DIR go together");
+    }
+    options.planner.verbose = true;
+    return options;
+}
+
 std::string get_folder_path()
 {
     std::string folder;
@@ -31,22 +238,62 @@ std::string get_folder_path()
     return folder;
 }
 
-void display_system_info(int num_cores, int max_threads, int s_rows, int s_cols, int t_rows, int t_cols)
+void display_system_info(int num_cores, int max_threads, const Matrix &S, const Matrix &T,
+                         int T_rows, int T_cols, const Options &options)
 {
     std::cout << "\nSystem Information:\n";
     std::cout << "-------------------\n";
     std::cout << "Available cores: " << num_cores << "\n";
+    const Topology topology = Topology::detect();
+    std::cout << "Topology: " << topology.describe() << "\n";
+    std::cout << "Placement: " << placement_name(options.placement);
+    std::vector<int> cpus = placement_cpus(topology, options.placement);
+    if (!cpus.empty())
+    {
+        std::cout << " (worker CPUs";
+        for (size_t k = 0; k < cpus.size() && k < 16; ++k)
+        {
+            std::cout << (k ? "," : " ") << cpus[k];
+        }
+        std::cout << (cpus.size() > 16 ? ",...)" : ")");
+    }
+    std::cout << "\n";
     std::cout << "\nComputation Parameters:\n";
     std::cout << "-------------------\n";
+    std::cout << "Engine: " << (options.fused ? "fused" : engine_name(options.engine)) << "\n";
     std::cout << "Maximum threads: " << max_threads << "\n";
-    std::cout << "Matrix S dimensions: " << s_rows << "x" << s_cols << "\n";
-    std::cout << "Matrix T dimensions: " << t_rows << "x" << t_cols << "\n\n";
+    if (!options.templates.empty())
+    {
+        std::cout << "Templates: " << options.templates << "\n";
+    }
+    if (!options.frames.empty())
+    {
+        std::cout << "Frames: " << options.frames << "\n";
+    }
+    else
+    {
+        std::cout << "Matrix S dimensions: " << S.rows() << "x" << S.cols() << "\n";
+    }
+    std::cout << "Matrix T dimensions: " << T_rows << "x" << T_cols << "\n";
+    std::cout << "Storage: " << element_width_name(options.storage) << " (";
+    if (T.empty())
+    {
+        std::cout << "T streamed in bands)\n\n";
+    }
+    else
+    {
+        std::cout << T.bytes() / (1024.0 * 1024.0) << " MB for T)\n\n";
+    }
 }
 
-double run_method(const Method &method, const std::vector<int> &S, const std::vector<int> &T,
-                  int s_rows, int s_cols, int t_rows, int t_cols, int threads_count,
-                  const std::string &data_path)
+// T is empty for the stream engine, which reads T_file band by band instead. With
+// --trace, the direct search's timeline is appended to traces.
+double run_method(const Method &method, const Matrix &S, const Matrix &T, const std::string &T_file,
+                  int T_rows, int T_cols, int threads_count, const std::string &data_path, const Options &options,
+                  ThreadPool &pool, std::vector<RunTrace> &traces)
 {
+    const Engine engine = options.engine;
+    const ResultOptions &result_options = options.results;
     std::cout << "\n[Computing " << method.name << " with " << threads_count
               << " thread" << (threads_count > 1 ? "s" : "") << "]\n";
 
@@ -56,62 +303,468 @@ double run_method(const Method &method, const std::vector<int> &S, const std::ve
 
     std::vector<std::pair<int, int>> best_positions;
     double best_value;
-    if (threads_count > 1)
+    SchedulerStats stats;
+    BoundStats bound_stats;
+    bool bounded = engine == Engine::BranchBound && method.metric == Metric::SSD;
+    ExactStats exact_stats;
+    PyramidStats pyramid_stats;
+    StreamStats stream_stats;
+    bool exact = engine == Engine::Exact && method.metric == Metric::SSD;
+    if (exact)
+    {
+        compute_exact(S, T, best_positions, threads_count, &pool, &exact_stats);
+    }
+    std::vector<ScoredPosition> ranked;
+    bool ranked_mode = result_options.mode != ResultMode::Best;
+    if (exact && !best_positions.empty())
+    {
+        best_value = 0.0; // S occurs verbatim, so nothing beats SSD 0
+    }
+    else if (bounded)
+    {
+        compute_ssd_bounded(S, T, best_positions, best_value, threads_count, &pool, &bound_stats, &stats);
+    }
+    else if (engine == Engine::Stream)
+    {
+        compute_streaming(S, T_file, T_rows, T_cols, method.metric, options.storage, options.band_rows,
+                          best_positions, best_value, threads_count, &pool, &stream_stats);
+    }
+    else if (engine == Engine::Pyramid)
+    {
+        compute_pyramid(S, T, method.metric, best_positions, best_value, threads_count, &pool, &pyramid_stats);
+    }
+    else if (engine == Engine::Integral)
+    {
+        compute_integral(S, T, method.metric, best_positions, best_value, threads_count, &pool);
+    }
+    else if (engine == Engine::SIMD)
+    {
+        compute_simd(S, T, method.metric, best_positions, best_value, threads_count, &pool);
+    }
+    else if (engine == Engine::FFT)
     {
-        compute_parallel(S, T, s_rows, s_cols, t_rows, t_cols, method.compute_func,
-                         method.find_max, best_positions, best_value, threads_count);
+        compute_fft(S, T, method.metric, best_positions, best_value, threads_count, &pool);
     }
     else
     {
-        compute(S, T, s_rows, s_cols, t_rows, t_cols, method.compute_func,
-                method.find_max, best_positions, best_value);
+        // Direct search, also the fallback of exact and bnb; the template statistics
+        // are computed once here and only read by the search
+        Matcher matcher(S, method.metric);
+        MatchOptions match_options;
+        match_options.results = result_options;
+        match_options.threads = threads_count;
+        match_options.pool = &pool;
+        match_options.stats = &stats;
+        RunTrace trace;
+        trace.name = method.name + ", " + std::to_string(threads_count) + " threads";
+        trace.counters = options.counters;
+        if (!options.trace.empty())
+        {
+            match_options.trace = &trace;
+        }
+        MatchResult result = matcher.match(T, match_options);
+        if (match_options.trace)
+        {
+            print_trace_report(trace, std::cout);
+            traces.push_back(std::move(trace));
+        }
+        best_value = result.best_value;
+        best_positions = std::move(result.best_positions);
+        ranked = std::move(result.ranked);
     }
 
     auto end = std::chrono::high_resolution_clock::now();
     double time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
 
-    display_results(method.name, best_positions, best_value, time);
-    write_to_csv(data_path, s_rows, s_cols, t_rows, t_cols, method.name, threads_count,
+    if (ranked_mode)
+    {
+        display_ranked_results(method.name, ranked, time);
+    }
+    else
+    {
+        display_results(method.name, best_positions, best_value, time);
+    }
+    if (!stats.tiles_run.empty())
+    {
+        // 每個 worker 的 tile 數與偷取數
+        std::cout << "Tiles per worker:";
+        for (size_t w = 0; w < stats.tiles_run.size(); ++w)
+        {
+            std::cout << " " << stats.tiles_run[w] << "(" << stats.steals[w] << " stolen)";
+        }
+        std::cout << "\n";
+    }
+    if (bounded)
+    {
+        std::cout << "Pixels evaluated: " << bound_stats.pixels_evaluated << " of " << bound_stats.pixels_total
+                  << " (" << std::setprecision(2)
+                  << 100.0 * bound_stats.pixels_evaluated / std::max(bound_stats.pixels_total, 1LL)
+                  << "%), windows rejected early: " << bound_stats.windows_rejected << " of "
+                  << bound_stats.windows << "\n"
+                  << std::setprecision(6);
+    }
+    if (engine == Engine::Stream)
+    {
+        std::cout << "Bands: " << stream_stats.bands << " of " << stream_stats.band_rows << " rows, buffers "
+                  << std::setprecision(2) << stream_stats.buffer_bytes / (1024.0 * 1024.0) << " MB, load "
+                  << stream_stats.load_seconds << " s, stalled " << stream_stats.stall_seconds << " s\n"
+                  << std::setprecision(6);
+    }
+    if (engine == Engine::Pyramid)
+    {
+        // 每層剪枝比例
+        for (const auto &level : pyramid_stats.levels)
+        {
+            std::cout << "Level " << level.block << "x" << level.block << ": " << level.survivors << " of "
+                      << level.candidates << " kept (" << std::setprecision(2)
+                      << 100.0 * (level.candidates - level.survivors) / std::max(level.candidates, 1LL)
+                      << "% pruned)\n"
+                      << std::setprecision(6);
+        }
+        std::cout << "Full-resolution scoring: " << pyramid_stats.full_scored << " of "
+                  << pyramid_stats.positions << " positions\n";
+    }
+    if (exact)
+    {
+        std::cout << "Hash hits: " << exact_stats.hash_hits << ", verified matches: " << exact_stats.matches << "\n";
+    }
+    write_to_csv(data_path, S.rows(), S.cols(), T_rows, T_cols, method.name, threads_count,
                  best_positions, best_value, time);
 
     return time;
 }
 
-int main()
+// Production mode: plan (or look up) the configuration for this shape and run it once
+double run_planned(const Method &method, const Matrix &S, const Matrix &T, const std::string &data_path,
+                   const Options &options, ThreadPool &pool)
+{
+    std::cout << "\n[Planning " << method.name << "]\n";
+    auto plan_start = std::chrono::high_resolution_clock::now();
+    Plan plan = plan_match(S, T, method.metric, pool, options.planner);
+    auto plan_end = std::chrono::high_resolution_clock::now();
+    std::cout << "Plan: " << describe_plan(plan) << " (predicted " << plan.predicted_seconds * 1e3 << " ms, "
+              << (plan.cached ? "from " + options.planner.tuning_file
+                              : "tuned in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                                 plan_end - plan_start)
+                                                                 .count()) +
+                                    " ms")
+              << ")\n";
+
+    reset_csv(data_path);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::pair<int, int>> best_positions;
+    double best_value;
+    run_plan(plan, method.metric, S, T, best_positions, best_value, &pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    double time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+    display_results(method.name, best_positions, best_value, time);
+    write_to_csv(data_path, S.rows(), S.cols(), T.rows(), T.cols(), method.name, plan.threads, best_positions,
+                 best_value, time);
+    return time;
+}
+
+// One traversal for every requested metric; each metric is reported and logged
+// with the shared pass time
+double run_fused(const std::vector<Metric> &metrics, const Matrix &S, const Matrix &T, int threads_count,
+                 const std::string &data_path, ThreadPool &pool)
+{
+    std::cout << "\n[Computing";
+    for (Metric metric : metrics)
+    {
+        std::cout << " " << metric_name(metric);
+    }
+    std::cout << " in one pass with " << threads_count << " thread" << (threads_count > 1 ? "s" : "") << "]\n";
+
+    reset_csv(data_path);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MultiMetricResult result;
+    compute_fused(S, T, metrics, result, threads_count, &pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    double time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+    for (const auto &metric_result : result.results)
+    {
+        std::string name = metric_name(metric_result.metric);
+        display_results(name, metric_result.best_positions, metric_result.best_value, time);
+        write_to_csv(data_path, S.rows(), S.cols(), T.rows(), T.cols(), name, threads_count,
+                     metric_result.best_positions, metric_result.best_value, time);
+    }
+    return time;
+}
+
+// Every template against T in one tiled pass; each template is reported and logged
+// under its own name with the shared pass time
+double run_batch(Metric metric, const std::vector<BatchTemplate> &templates, const Matrix &T, int threads_count,
+                 const std::string &data_path, ThreadPool &pool)
+{
+    std::cout << "\n[Computing " << metric_name(metric) << " for " << templates.size() << " templates with "
+              << threads_count << " thread" << (threads_count > 1 ? "s" : "") << "]\n";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<TemplateResult> results;
+    compute_batch(templates, T, metric, results, threads_count, &pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    double time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const BatchTemplate &t = templates[k];
+        display_results(std::string(metric_name(metric)) + " " + t.name, results[k].best_positions,
+                        results[k].best_value, time);
+        write_to_csv(data_path + "/" + t.name, t.rows, t.cols, T.rows(), T.cols(), metric_name(metric),
+                     threads_count, results[k].best_positions, results[k].best_value, time);
+    }
+    std::cout << "Pass time per template: " << time / templates.size() * 1e3 << " ms\n";
+    return time;
+}
+
+// Load T while scoring the first metric on it; T receives the parsed matrix for the
+// sweep that follows. Reports and logs load and compute as one end-to-end time,
+// under "<metric> pipelined" so the sweep's rows for the metric stay compute-only.
+void run_pipelined(const Method &method, const Matrix &S, Matrix &T, const std::string &T_file,
+                   int T_rows, int T_cols, int threads_count, const std::string &data_path, const Options &options,
+                   ThreadPool &pool)
+{
+    std::cout << "\n[Loading T and computing " << method.name << " with " << threads_count
+              << " thread" << (threads_count > 1 ? "s" : "") << "]\n";
+
+    std::vector<std::pair<int, int>> best_positions;
+    double best_value;
+    PipelineStats stats;
+    compute_pipelined(S, T_file, T_rows, T_cols, method.metric, options.storage, T, best_positions, best_value,
+                      threads_count, &pool, &stats);
+
+    display_results(method.name, best_positions, best_value, stats.total_seconds);
+    std::cout << "Parse finished at " << stats.parse_seconds << " s, end-to-end " << stats.total_seconds
+              << " s, workers waited " << stats.wait_seconds << " s on the row watermark\n";
+    write_to_csv(data_path, S.rows(), S.cols(), T_rows, T_cols, method.name + " pipelined", threads_count,
+                 best_positions, best_value, stats.total_seconds);
+}
+
+// Incremental mode: match T as the first frame, then each frame of --frames in name
+// order, rescoring only the windows over the rows that changed since the previous
+// frame. A frame's time covers the diff and the update, not the load.
+void run_frames(const Method &method, const Matrix &S, const Matrix &T, const std::vector<std::string> &frame_files,
+                int threads_count, const std::string &data_path, const Options &options, ThreadPool &pool)
+{
+    std::cout << "\n[Computing " << method.name << " over " << frame_files.size() + 1 << " frames with "
+              << threads_count << " thread" << (threads_count > 1 ? "s" : "") << "]\n";
+
+    IncrementalMatch match(S, method.metric);
+    auto start = std::chrono::high_resolution_clock::now();
+    match.reset(T, threads_count, &pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    double time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+    display_results(method.name, match.best_positions(), match.best_value(), time);
+    write_to_csv(data_path, S.rows(), S.cols(), T.rows(), T.cols(), method.name, threads_count,
+                 match.best_positions(), match.best_value(), time);
+
+    Matrix previous = T;
+    for (const auto &file : frame_files)
+    {
+        int rows, cols;
+        parse_filename(fs::path(file).filename().string(), rows, cols);
+        if (rows != T.rows() || cols != T.cols())
+        {
+            throw std::runtime_error("Frame dimensions do not match T: " + file);
+        }
+        Matrix frame = read_matrix(file, rows, cols, options.storage, threads_count, &pool);
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<DirtyRect> dirty = diff_frames(previous, frame);
+        IncrementalStats stats;
+        match.update(frame, dirty, threads_count, &pool, &stats);
+        end = std::chrono::high_resolution_clock::now();
+        time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+        const std::string name = fs::path(file).stem().string();
+        display_results(method.name + " " + name, match.best_positions(), match.best_value(), time);
+        std::cout << "Changed rows: " << dirty.size() << ", windows rescored: " << stats.rescored
+                  << ", blocks rebuilt: " << stats.blocks << " of " << stats.blocks_total << "\n";
+        write_to_csv(data_path + "/" + name, S.rows(), S.cols(), T.rows(), T.cols(), method.name, threads_count,
+                     match.best_positions(), match.best_value(), time);
+        previous = frame;
+    }
+}
+
+// Daemon mode: load every T* matrix of the scene folders once, then answer match
+// requests on the socket until shut down
+void run_server(const Options &options, int num_cores)
+{
+    ThreadPool pool(num_cores);
+    apply_placement(pool, options.placement);
+    std::vector<Scene> scenes;
+    for (const auto &folder : options.scenes)
+    {
+        for (const auto &file : find_matrix_files(folder, 'T'))
+        {
+            int rows, cols;
+            parse_filename(fs::path(file).filename().string(), rows, cols);
+            Matrix T = read_matrix(file, rows, cols, options.storage, num_cores, &pool);
+            if (options.placement == Placement::NumaLocal)
+            {
+                T = node_local_copy(T, num_cores, &pool);
+            }
+            scenes.push_back({fs::path(file).stem().string(), T});
+        }
+    }
+    if (scenes.empty())
+    {
+        throw std::runtime_error("No T* matrix files found in the scene folders");
+    }
+    std::cout << "Topology: " << Topology::detect().describe() << ", placement "
+              << placement_name(options.placement) << "\n";
+    serve(scenes, pool, options.server);
+}
+
+int main(int argc, char *argv[])
 {
     std::cout << std::fixed << std::setprecision(6);
-    std::string folder = get_folder_path();
     int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
 
     try
     {
+        Options options = parse_options(argc, argv);
+        if (!options.server.socket_path.empty())
+        {
+            run_server(options, num_cores);
+            return 0;
+        }
+        std::string folder = get_folder_path();
         std::string s_file, t_file;
         int s_rows, s_cols, t_rows, t_cols;
         find_files(folder, s_file, t_file, s_rows, s_cols, t_rows, t_cols);
+        std::vector<std::string> template_files;
+        if (!options.templates.empty())
+        {
+            template_files = find_template_files(options.templates);
+        }
+        std::vector<std::string> frame_files;
+        if (!options.frames.empty())
+        {
+            frame_files = find_matrix_files(options.frames, 'T');
+            if (frame_files.empty())
+            {
+                throw std::runtime_error("Could not find any frame files in folder: " + options.frames);
+            }
+        }
 
-        std::vector<int> S, T;
-        read_arrays(s_file, t_file, s_rows, s_cols, t_rows, t_cols, S, T);
+        // 執行緒池只建立一次，讀檔與所有方法、執行緒數共用
+        ThreadPool pool(num_cores);
+        apply_placement(pool, options.placement);
 
-        std::vector<Method> methods = {
-            {"PCC", compute_pcc, true},
-            {"SSD", compute_ssd, false}};
+        std::vector<Method> methods;
+        for (Metric metric : options.metrics)
+        {
+            methods.push_back({metric_name(metric), metric});
+        }
+
+        Matrix S, T;
+        std::vector<BatchTemplate> templates;
+        if (!options.templates.empty())
+        {
+            // 樣板統計量只算一次
+            T = read_matrix(t_file, t_rows, t_cols, options.storage, num_cores, &pool);
+            s_rows = t_rows; // max_i below follows the smallest template
+            for (const auto &file : template_files)
+            {
+                int rows, cols;
+                parse_filename(fs::path(file).filename().string(), rows, cols);
+                templates.push_back(prepare_template(read_matrix(file, rows, cols, options.storage, 1, &pool),
+                                                     fs::path(file).stem().string()));
+                s_rows = std::min(s_rows, rows);
+            }
+        }
+        else if (options.engine == Engine::Stream)
+        {
+            S = read_matrix(s_file, s_rows, s_cols, options.storage, 1, &pool); // T stays on disk
+        }
+        else if (options.pipeline)
+        {
+            // 邊讀 T 邊計算第一個指標
+            S = read_matrix(s_file, s_rows, s_cols, options.storage, 1, &pool);
+            run_pipelined(methods.front(), S, T, t_file, t_rows, t_cols, num_cores, folder, options, pool);
+        }
+        else
+        {
+            read_arrays(s_file, t_file, s_rows, s_cols, t_rows, t_cols, S, T, options.storage, &pool);
+        }
+        if (options.build_cache)
+        {
+            // 寫出二進位快取，下次啟動直接 mmap
+            for (const auto &[file, matrix] : {std::make_pair(s_file, S), std::make_pair(t_file, T)})
+            {
+                if (fs::path(file).extension() == ".txt" && !matrix.empty())
+                {
+                    write_binary_matrix(binary_path_for(file), matrix);
+                    std::cout << "Wrote binary cache: " << binary_path_for(file) << "\n";
+                }
+            }
+        }
 
         int max_i = t_rows - s_rows + 1;
         int max_threads = std::min(num_cores, max_i);
 
-        display_system_info(num_cores, max_threads, s_rows, s_cols, t_rows, t_cols);
+        display_system_info(num_cores, max_threads, S, T, t_rows, t_cols, options);
 
+        if (options.plan)
+        {
+            Matrix T_local = options.placement == Placement::NumaLocal ? node_local_copy(T, num_cores, &pool) : T;
+            for (const auto &method : methods)
+            {
+                run_planned(method, S, T_local, folder, options, pool);
+            }
+            return 0;
+        }
+        if (!frame_files.empty())
+        {
+            for (const auto &method : methods)
+            {
+                run_frames(method, S, T, frame_files, num_cores, folder, options, pool);
+            }
+            return 0;
+        }
+
+        std::vector<RunTrace> traces;
         for (int threads_count = 1; threads_count <= max_threads; ++threads_count)
         {
             std::cout << "=== Starting computations with " << threads_count
                       << " thread" << (threads_count > 1 ? "s" : "") << " ===\n";
 
-            for (const auto &method : methods)
+            // NUMA-local: 每個 worker 先觸碰自己掃描的 T 區段（不計入計時）
+            Matrix T_local = T;
+            if (options.placement == Placement::NumaLocal && !T.empty())
             {
-                run_method(method, S, T, s_rows, s_cols, t_rows, t_cols, threads_count, folder);
+                T_local = node_local_copy(T, threads_count, &pool);
+            }
+
+            if (!templates.empty())
+            {
+                for (Metric metric : options.metrics)
+                {
+                    run_batch(metric, templates, T_local, threads_count, folder, pool);
+                }
+            }
+            else if (options.fused)
+            {
+                run_fused(options.metrics, S, T_local, threads_count, folder, pool);
+            }
+            else
+            {
+                for (const auto &method : methods)
+                {
+                    run_method(method, S, T_local, t_file, t_rows, t_cols, threads_count, folder, options, pool, traces);
+                }
             }
             std::cout << "\n";
         }
+        if (!options.trace.empty())
+        {
+            write_chrome_trace(options.trace, traces);
+            std::cout << "Wrote trace: " << options.trace << "\n";
+        }
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,292 @@
+#include "matcher.hpp"
+#include "kernel.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+#include <cmath>
+#include <stdexcept>
+
+Matcher::Matcher(const Matrix &S, Metric metric) : metric_(metric), rows_(S.rows()), cols_(S.cols())
+{
+    if (S.empty())
+    {
+        throw std::invalid_argument("Template must not be empty");
+    }
+    values_ = S.to_vector();
+    for (int y : values_)
+    {
+        sum_Y_ += y;
+        sum_YY_ += static_cast<long long>(y) * y;
+    }
+    const long long n = values_.size();
+    centered_.reserve(n); // 預分配空間
+    for (int y : values_)
+    {
+        centered_.push_back(static_cast<int>(n * y - sum_Y_));
+    }
+    sqrt_var_Y_ = std::sqrt(static_cast<double>(n * sum_YY_ - sum_Y_ * sum_Y_));
+    sqrt_sum_YY_ = std::sqrt(static_cast<double>(sum_YY_));
+}
+
+double Matcher::mean() const
+{
+    return static_cast<double>(sum_Y_) / values_.size();
+}
+
+double Matcher::norm() const
+{
+    return sqrt_var_Y_ / std::sqrt(static_cast<double>(values_.size()));
+}
+
+// Largest window for which compare_pcc_exact cannot overflow 128 bits
+static const long long exact_pcc_max_pixels = 1 << 17;
+
+namespace
+{
+    // Read-only view of a Matcher's cache for the tile kernels
+    struct MatchContext
+    {
+        const int *S, *centered;
+        int S_rows, S_cols;
+        TemplateCache cache;
+        const ResultOptions *options;
+        bool exact_pcc; // best PCC tracked as the exact key num / sqrt(var_X)
+    };
+
+    struct MatchWorker
+    {
+        LocalBest best;
+        long long best_num = 0, best_var = 1; // exact PCC key of best.value
+        bool has_best = false;
+        std::vector<ScoredPosition> heap;
+        std::vector<uint8_t> unpacked; // nibble tiles
+    };
+
+    // Exact PCC best + ties; a flat window (var_X = 0) or template scores 0
+    inline void update_best_exact(long long num, long long var_X, int i, int j, MatchWorker &worker)
+    {
+        if (var_X == 0)
+        {
+            num = 0;
+            var_X = 1;
+        }
+        int order = worker.has_best ? compare_pcc_exact(num, var_X, worker.best_num, worker.best_var) : 1;
+        if (order > 0)
+        {
+            worker.best_num = num;
+            worker.best_var = var_X;
+            worker.has_best = true;
+            worker.best.positions.clear();
+            worker.best.positions.push_back({i, j});
+        }
+        else if (order == 0)
+        {
+            worker.best.positions.push_back({i, j});
+        }
+    }
+
+    // Window kernel of each metric; PCC runs against the centred template and, like
+    // NCC, takes the template half of its denominator from the cache
+    template <Metric M>
+    struct MatchKernel
+    {
+        using type = SSDKernel;
+    };
+    template <>
+    struct MatchKernel<Metric::PCC>
+    {
+        using type = CenteredPCCKernel;
+    };
+    template <>
+    struct MatchKernel<Metric::SAD>
+    {
+        using type = SADKernel;
+    };
+    template <>
+    struct MatchKernel<Metric::NCC>
+    {
+        using type = CachedNCCKernel;
+    };
+
+    // Score positions [tile.i0, tile.i1) x [tile.j0, tile.j1); `window` points at the tile's top-left pixel
+    template <Metric M, int R, int C, bool Collect, class Pixel>
+    void match_tile(const MatchContext &ctx, const Pixel *window, size_t stride, const Tile &tile,
+                    MatchWorker &worker)
+    {
+        using Accumulator = typename MatchKernel<M>::type::Accumulator;
+        const int n = ctx.S_rows * ctx.S_cols;
+        const bool find_max = metric_find_max(M);
+        const int *Y = M == Metric::PCC ? ctx.centered : ctx.S;
+        scan_tile<Accumulator, R, C>(
+            window, stride, Y, ctx.S_rows, ctx.S_cols, tile.i0, tile.i1, tile.j0, tile.j1,
+            [&](const Accumulator &acc, int i, int j)
+            {
+                if constexpr (M == Metric::PCC && !Collect)
+                {
+                    if (ctx.exact_pcc)
+                    {
+                        update_best_exact(ctx.cache.sqrt_var_Y == 0.0 ? 0 : acc.sum_XC, acc.var_X(n), i, j, worker);
+                        return;
+                    }
+                }
+                double value = cached_result(acc, n, ctx.cache);
+                if (Collect)
+                {
+                    offer_result({value, i, j}, *ctx.options, find_max, worker.heap);
+                }
+                else
+                {
+                    update_best(value, i, j, find_max, worker.best.value, worker.best.positions);
+                }
+            });
+    }
+
+    template <class Pixel>
+    using MatchTileFunc = void (*)(const MatchContext &, const Pixel *, size_t, const Tile &, MatchWorker &);
+
+    template <Metric M, class Pixel>
+    MatchTileFunc<Pixel> select_shape(int S_rows, int S_cols, bool collect)
+    {
+        return dispatch_shape(S_rows, S_cols, [collect](auto R, auto C)
+                              { return collect ? match_tile<M, R, C, true, Pixel> : match_tile<M, R, C, false, Pixel>; });
+    }
+
+    template <class Pixel>
+    MatchTileFunc<Pixel> select_match(Metric metric, int S_rows, int S_cols, bool collect)
+    {
+        switch (metric)
+        {
+        case Metric::PCC:
+            return select_shape<Metric::PCC, Pixel>(S_rows, S_cols, collect);
+        case Metric::SSD:
+            return select_shape<Metric::SSD, Pixel>(S_rows, S_cols, collect);
+        case Metric::SAD:
+            return select_shape<Metric::SAD, Pixel>(S_rows, S_cols, collect);
+        default:
+            return select_shape<Metric::NCC, Pixel>(S_rows, S_cols, collect);
+        }
+    }
+}
+
+MatchResult Matcher::match(const Matrix &T, const MatchOptions &options) const
+{
+    if (rows_ > T.rows() || cols_ > T.cols())
+    {
+        throw std::invalid_argument("Template is larger than T");
+    }
+    const ResultOptions &results = options.results;
+    const bool collect = results.mode != ResultMode::Best;
+    validate_result_options(results);
+    RunTrace *trace = options.trace;
+    if (trace)
+    {
+        trace->begin();
+    }
+    const bool find_max = metric_find_max(metric_);
+    const bool exact_pcc = metric_ == Metric::PCC && !collect && values_.size() <= exact_pcc_max_pixels;
+    const ResultOptions candidates = ranked_candidates(results);
+    MatchContext ctx{values_.data(), centered_.data(), rows_, cols_, {sqrt_var_Y_, sqrt_sum_YY_}, &candidates,
+                     exact_pcc};
+    auto int_tile = select_match<int32_t>(metric_, rows_, cols_, collect);
+    auto byte_tile = select_match<uint8_t>(metric_, rows_, cols_, collect);
+
+    const int max_i = T.rows() - rows_ + 1;
+    const int max_j = T.cols() - cols_ + 1;
+    int threads_count = options.threads > 0 ? options.threads : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int num_workers = resolve_thread_count(threads_count, max_i * max_j, options.pool);
+    std::vector<Tile> tiles = make_tiles(max_i, max_j, rows_, cols_, T.width(), num_workers, options.tile_rows,
+                                         options.tile_cols);
+
+    MatchWorker reset;
+    reset.best.value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    std::vector<MatchWorker> workers(num_workers, reset);
+    run_tiles(
+        tiles, num_workers,
+        [&](int w, const Tile &tile)
+        {
+            MatchWorker &worker = workers[w];
+            switch (T.width())
+            {
+            case ElementWidth::Int32:
+                int_tile(ctx, T.row<int32_t>(tile.i0) + tile.j0, T.stride() / sizeof(int32_t), tile, worker);
+                break;
+            case ElementWidth::UInt8:
+                byte_tile(ctx, T.row<uint8_t>(tile.i0) + tile.j0, T.stride(), tile, worker);
+                break;
+            default:
+            {
+                int cols = tile.j1 - tile.j0 + cols_ - 1;
+                unpack_tile(T, tile.i0, tile.j0, tile.i1 - tile.i0 + rows_ - 1, cols, worker.unpacked);
+                byte_tile(ctx, worker.unpacked.data(), cols, tile, worker);
+                break;
+            }
+            }
+        },
+        options.stats, options.pool, trace);
+
+    // 合併結果
+    double merge_start = trace ? trace->now() : 0.0;
+    auto finish = [&]()
+    {
+        if (trace)
+        {
+            trace->total = trace->now();
+            trace->merge = trace->total - merge_start;
+        }
+    };
+    MatchResult result;
+    if (collect)
+    {
+        std::vector<std::vector<ScoredPosition>> lists;
+        for (auto &worker : workers)
+        {
+            lists.push_back(std::move(worker.heap));
+        }
+        merge_ranked(lists, results, find_max, result.ranked, threads_count, options.pool);
+        result.best_value = result.ranked.empty() ? 0.0 : result.ranked.front().value;
+        for (const auto &scored : result.ranked)
+        {
+            result.best_positions.push_back({scored.i, scored.j});
+        }
+        finish();
+        return result;
+    }
+    if (exact_pcc)
+    {
+        // Exact merge of the worker keys; the value is formed once, as pcc_from_sums would
+        long long num = 0, var_X = 1;
+        bool has_best = false;
+        for (const auto &worker : workers)
+        {
+            int order = !worker.has_best ? -1
+                        : has_best       ? compare_pcc_exact(worker.best_num, worker.best_var, num, var_X)
+                                         : 1;
+            if (order > 0)
+            {
+                num = worker.best_num;
+                var_X = worker.best_var;
+                has_best = true;
+                result.best_positions = worker.best.positions;
+            }
+            else if (order == 0)
+            {
+                result.best_positions.insert(result.best_positions.end(), worker.best.positions.begin(),
+                                             worker.best.positions.end());
+            }
+        }
+        result.best_value = num == 0 ? 0.0
+                                     : static_cast<double>(num) /
+                                           (std::sqrt(static_cast<double>(var_X)) * sqrt_var_Y_);
+        std::sort(result.best_positions.begin(), result.best_positions.end());
+        finish();
+        return result;
+    }
+    result.best_value = reset.best.value;
+    for (const auto &worker : workers)
+    {
+        merge_best(worker.best.value, worker.best.positions, find_max, result.best_value, result.best_positions);
+    }
+    // Tiles finish in any order; keep the serial row-major order
+    std::sort(result.best_positions.begin(), result.best_positions.end());
+    finish();
+    return result;
+}
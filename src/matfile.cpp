@@ -0,0 +1,182 @@
+#include "matfile.hpp"
+#include "utils.hpp"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char matrix_file_magic[8] = {'E', 'M', 'C', 'S', 'S', 'M', 'A', 'T'};
+
+MappedFile::MappedFile(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Could not stat file: " + filename);
+    }
+    size = st.st_size;
+    if (size > 0)
+    {
+        void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Could not mmap file: " + filename);
+        }
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(p);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+    {
+        munmap(const_cast<char *>(data), size);
+    }
+}
+
+// 64-bit FNV-style hash over 8-byte words (byte-wise for the tail)
+uint64_t matrix_checksum(const uint8_t *data, size_t size)
+{
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + k, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; k < size; ++k)
+    {
+        hash = (hash ^ data[k]) * prime;
+    }
+    return hash;
+}
+
+std::string binary_path_for(const std::string &text_file)
+{
+    return fs::path(text_file).replace_extension(".bin").string();
+}
+
+bool binary_is_fresh(const std::string &text_file)
+{
+    std::string bin = binary_path_for(text_file);
+    std::error_code ec;
+    if (!fs::exists(bin, ec))
+    {
+        return false;
+    }
+    if (!fs::exists(text_file, ec))
+    {
+        return true; // cache only
+    }
+    return fs::last_write_time(bin, ec) >= fs::last_write_time(text_file, ec);
+}
+
+void write_binary_matrix(const std::string &filename, const Matrix &matrix)
+{
+    MatrixFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, matrix_file_magic, sizeof(header.magic));
+    header.version = matrix_file_version;
+    header.element_width = static_cast<uint32_t>(matrix.width());
+    header.rows = matrix.rows();
+    header.cols = matrix.cols();
+    header.stride = matrix.stride();
+    header.data_bytes = matrix.bytes();
+    header.checksum = matrix.rows() > 0 ? matrix_checksum(matrix.row_bytes(0), matrix.bytes()) : 0;
+
+    // Write to a temporary name and rename, so readers never see a partial file
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            throw std::runtime_error("Failed to open file for writing: " + tmp);
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (matrix.rows() > 0)
+        {
+            out.write(reinterpret_cast<const char *>(matrix.row_bytes(0)), matrix.bytes());
+        }
+        char tail[Matrix::alignment] = {};
+        out.write(tail, sizeof(tail));
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write file: " + tmp);
+        }
+    }
+    fs::rename(tmp, filename);
+}
+
+void validate_matrix_header(const MatrixFileHeader &header, size_t file_size, const std::string &filename)
+{
+    if (std::memcmp(header.magic, matrix_file_magic, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error("Not a binary matrix file: " + filename);
+    }
+    if (header.version != matrix_file_version)
+    {
+        throw std::runtime_error("Unsupported binary matrix version in file: " + filename);
+    }
+    if (header.element_width > static_cast<uint32_t>(ElementWidth::Nibble) || header.rows < 0 || header.cols < 0)
+    {
+        throw std::runtime_error("Corrupt binary matrix header in file: " + filename);
+    }
+    ElementWidth width = static_cast<ElementWidth>(header.element_width);
+    if (header.stride != Matrix::row_stride(header.cols, width) ||
+        header.data_bytes != header.stride * static_cast<uint64_t>(header.rows) ||
+        file_size < sizeof(MatrixFileHeader) + header.data_bytes + Matrix::alignment)
+    {
+        throw std::runtime_error("Corrupt binary matrix header in file: " + filename);
+    }
+}
+
+Matrix map_binary_matrix(const std::string &filename, int expected_rows, int expected_cols, bool verify)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    auto file = std::make_shared<MappedFile>(filename);
+    if (file->size < sizeof(MatrixFileHeader))
+    {
+        throw std::runtime_error("Binary matrix file is truncated: " + filename);
+    }
+    MatrixFileHeader header;
+    std::memcpy(&header, file->data, sizeof(header));
+    validate_matrix_header(header, file->size, filename);
+    ElementWidth width = static_cast<ElementWidth>(header.element_width);
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(file->data) + sizeof(MatrixFileHeader);
+    if (verify && matrix_checksum(data, header.data_bytes) != header.checksum)
+    {
+        throw std::runtime_error("Checksum mismatch in file: " + filename);
+    }
+    if (header.rows != expected_rows || header.cols != expected_cols)
+    {
+        throw std::runtime_error("Array dimensions do not match filename: " + filename);
+    }
+
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::cout << "Mapped " << header.rows << " rows and " << header.cols << " columns from file: " << filename
+              << " (" << element_width_name(width) << ", "
+              << std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count() / 1e3
+              << " ms)" << std::endl;
+    return Matrix(header.rows, header.cols, width, header.stride, data, file);
+}
+
+void convert_to_binary(const std::string &text_file, int rows, int cols, ElementWidth width, int threads_count)
+{
+    Matrix matrix = load_matrix(text_file, rows, cols, width, threads_count);
+    std::string bin = binary_path_for(text_file);
+    write_binary_matrix(bin, matrix);
+    std::cout << "Wrote binary cache: " << bin << std::endl;
+}
@@ -0,0 +1,258 @@
+#include "matrix.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+const char *element_width_name(ElementWidth width)
+{
+    switch (width)
+    {
+    case ElementWidth::Int32:
+        return "int32";
+    case ElementWidth::Nibble:
+        return "nibble";
+    default:
+        return "uint8";
+    }
+}
+
+ElementWidth parse_element_width(const std::string &name)
+{
+    if (name == "int32")
+    {
+        return ElementWidth::Int32;
+    }
+    if (name == "uint8")
+    {
+        return ElementWidth::UInt8;
+    }
+    if (name == "nibble")
+    {
+        return ElementWidth::Nibble;
+    }
+    throw std::runtime_error("Unknown element width: " + name);
+}
+
+size_t Matrix::row_stride(int cols, ElementWidth width)
+{
+    size_t row_bytes;
+    switch (width)
+    {
+    case ElementWidth::Int32:
+        row_bytes = static_cast<size_t>(cols) * sizeof(int32_t);
+        break;
+    case ElementWidth::UInt8:
+        row_bytes = cols;
+        break;
+    default:
+        row_bytes = (static_cast<size_t>(cols) + 1) / 2;
+        break;
+    }
+    return (row_bytes + alignment - 1) / alignment * alignment;
+}
+
+Matrix::Matrix(int rows, int cols, ElementWidth width)
+    : rows_(rows), cols_(cols), width_(width), stride_(row_stride(cols, width))
+{
+    if (rows < 0 || cols < 0)
+    {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    size_t size = stride_ * rows_ + alignment; // zeroed tail for over-reading loads
+    uint8_t *buffer = static_cast<uint8_t *>(std::aligned_alloc(alignment, size));
+    if (!buffer)
+    {
+        throw std::bad_alloc();
+    }
+    std::memset(buffer, 0, size);
+    owner_ = std::shared_ptr<const void>(buffer, std::free);
+    data_ = buffer;
+    mutable_data_ = buffer;
+}
+
+Matrix::Matrix(int rows, int cols, ElementWidth width, size_t stride, const uint8_t *data,
+               std::shared_ptr<const void> owner)
+    : rows_(rows), cols_(cols), width_(width), stride_(stride), data_(data), owner_(std::move(owner))
+{
+}
+
+Matrix Matrix::uninitialized(int rows, int cols, ElementWidth width)
+{
+    if (rows < 0 || cols < 0)
+    {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    size_t stride = row_stride(cols, width);
+    uint8_t *buffer = static_cast<uint8_t *>(std::aligned_alloc(alignment, stride * rows + alignment));
+    if (!buffer)
+    {
+        throw std::bad_alloc();
+    }
+    std::memset(buffer + stride * rows, 0, alignment);
+    Matrix m(rows, cols, width, stride, buffer, std::shared_ptr<const void>(buffer, std::free));
+    m.mutable_data_ = buffer;
+    return m;
+}
+
+Matrix Matrix::from_vector(const std::vector<int> &values, int rows, int cols, ElementWidth width)
+{
+    if (values.size() != static_cast<size_t>(rows) * cols)
+    {
+        throw std::invalid_argument("Vector size does not match matrix dimensions");
+    }
+    Matrix m(rows, cols, width);
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int c = 0; c < cols; ++c)
+        {
+            m.set(r, c, values[static_cast<size_t>(r) * cols + c]);
+        }
+    }
+    return m;
+}
+
+void Matrix::set(int r, int c, int value)
+{
+    if (!mutable_data_)
+    {
+        throw std::logic_error("Matrix is read-only");
+    }
+    uint8_t *p = row_bytes(r);
+    switch (width_)
+    {
+    case ElementWidth::Int32:
+        reinterpret_cast<int32_t *>(p)[c] = value;
+        break;
+    case ElementWidth::UInt8:
+        p[c] = static_cast<uint8_t>(value);
+        break;
+    default:
+        if (c & 1)
+        {
+            p[c >> 1] = static_cast<uint8_t>((p[c >> 1] & 0x0f) | (value << 4));
+        }
+        else
+        {
+            p[c >> 1] = static_cast<uint8_t>((p[c >> 1] & 0xf0) | (value & 0x0f));
+        }
+        break;
+    }
+}
+
+void Matrix::unpack_row(int r, int c0, int count, uint8_t *out) const
+{
+    const uint8_t *p = row_bytes(r);
+    switch (width_)
+    {
+    case ElementWidth::Int32:
+    {
+        const int32_t *src = reinterpret_cast<const int32_t *>(p) + c0;
+        for (int c = 0; c < count; ++c)
+        {
+            out[c] = static_cast<uint8_t>(src[c]);
+        }
+        break;
+    }
+    case ElementWidth::UInt8:
+        std::memcpy(out, p + c0, count);
+        break;
+    default:
+    {
+        int c = 0;
+        // Leading odd column, then two pixels per byte
+        if (c0 & 1 && count > 0)
+        {
+            out[c++] = p[c0 >> 1] >> 4;
+        }
+        for (; c + 1 < count; c += 2)
+        {
+            uint8_t byte = p[(c0 + c) >> 1];
+            out[c] = byte & 0x0f;
+            out[c + 1] = byte >> 4;
+        }
+        if (c < count)
+        {
+            out[c] = p[(c0 + c) >> 1] & 0x0f;
+        }
+        break;
+    }
+    }
+}
+
+void Matrix::pack_row(int r, const uint8_t *values)
+{
+    if (!mutable_data_)
+    {
+        throw std::logic_error("Matrix is read-only");
+    }
+    uint8_t *p = row_bytes(r);
+    switch (width_)
+    {
+    case ElementWidth::Int32:
+    {
+        int32_t *dst = reinterpret_cast<int32_t *>(p);
+        for (int c = 0; c < cols_; ++c)
+        {
+            dst[c] = values[c];
+        }
+        break;
+    }
+    case ElementWidth::UInt8:
+        std::memcpy(p, values, cols_);
+        break;
+    default:
+    {
+        int c = 0;
+        for (; c + 1 < cols_; c += 2)
+        {
+            p[c >> 1] = static_cast<uint8_t>((values[c] & 0x0f) | (values[c + 1] << 4));
+        }
+        if (c < cols_)
+        {
+            p[c >> 1] = values[c] & 0x0f;
+        }
+        break;
+    }
+    }
+}
+
+std::vector<int> Matrix::to_vector() const
+{
+    std::vector<int> values(static_cast<size_t>(rows_) * cols_);
+    for (int r = 0; r < rows_; ++r)
+    {
+        for (int c = 0; c < cols_; ++c)
+        {
+            values[static_cast<size_t>(r) * cols_ + c] = at(r, c);
+        }
+    }
+    return values;
+}
+
+Matrix Matrix::clone() const
+{
+    Matrix m(rows_, cols_, width_);
+    // wrapped buffers may use a wider stride
+    for (int r = 0; r < rows_; ++r)
+    {
+        std::memcpy(m.row_bytes(r), row_bytes(r), std::min(stride_, m.stride_));
+    }
+    return m;
+}
+
+Matrix Matrix::as_width(ElementWidth width) const
+{
+    if (width == width_)
+    {
+        return *this;
+    }
+    Matrix m(rows_, cols_, width);
+    std::vector<uint8_t> buffer(cols_);
+    for (int r = 0; r < rows_; ++r)
+    {
+        unpack_row(r, 0, cols_, buffer.data());
+        m.pack_row(r, buffer.data());
+    }
+    return m;
+}
@@ -31,3 +31,28 @@ double compute_pcc(const std::vector<int> &X, const std::vector<int> &Y)
     }
     return numerator / denom;
 }
+
+// PCC from raw window sums: (nΣXY - ΣXΣY) / sqrt((nΣX² - (ΣX)²)(nΣY² - (ΣY)²))
+double pcc_from_sums(long long n, long long sum_X, long long sum_Y,
+                     long long sum_XX, long long sum_YY, long long sum_XY)
+{
+    long long numerator = n * sum_XY - sum_X * sum_Y;
+    long long var_X = n * sum_XX - sum_X * sum_X;
+    long long var_Y = n * sum_YY - sum_Y * sum_Y;
+    if (var_X == 0 || var_Y == 0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(numerator) /
+           (std::sqrt(static_cast<double>(var_X)) * std::sqrt(static_cast<double>(var_Y)));
+}
+
+double ncc_from_sums(long long sum_XX, long long sum_YY, long long sum_XY)
+{
+    if (sum_XX == 0 || sum_YY == 0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(sum_XY) /
+           (std::sqrt(static_cast<double>(sum_XX)) * std::sqrt(static_cast<double>(sum_YY)));
+}
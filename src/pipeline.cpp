@@ -0,0 +1,177 @@
+#include "pipeline.hpp"
+#include "matfile.hpp"
+#include <chrono>
+#include <memory>
+#include <numeric>
+
+RowWatermark::RowWatermark(const std::vector<ParseChunk> &chunks) : ready_(chunks.size(), 0)
+{
+    for (const auto &chunk : chunks)
+    {
+        first_.push_back(chunk.first_row);
+        lines_.push_back(chunk.lines);
+    }
+}
+
+void RowWatermark::publish(int chunk, int rows_parsed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_[chunk] = rows_parsed;
+    cv_.notify_all();
+}
+
+void RowWatermark::fail()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = true;
+    cv_.notify_all();
+}
+
+bool RowWatermark::wait_rows(int begin, int end)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ready = [&]
+    {
+        for (size_t c = 0; c < first_.size(); ++c)
+        {
+            int chunk_end = first_[c] + lines_[c];
+            if (chunk_end <= begin || first_[c] >= end)
+            {
+                continue;
+            }
+            if (first_[c] + ready_[c] < std::min(end, chunk_end))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    cv_.wait(lock, [&]
+             { return failed_ || ready(); });
+    return !failed_;
+}
+
+void compute_pipelined(const Matrix &S, const std::string &T_file, int T_rows, int T_cols, Metric metric,
+                       ElementWidth width, Matrix &T,
+                       std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                       ThreadPool *pool, PipelineStats *stats)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto start = clock::now();
+    if (S.empty() || T_rows <= 0 || T_cols <= 0 || S.rows() > T_rows || S.cols() > T_cols)
+    {
+        throw std::invalid_argument("Matrix dimensions are invalid");
+    }
+    if (fs::path(T_file).extension() == ".bin")
+    {
+        T = map_binary_matrix(T_file, T_rows, T_cols).as_width(width);
+        auto parsed = clock::now();
+        compute_parallel(S, T, metric, best_positions, best_value, threads_count, pool);
+        if (stats)
+        {
+            stats->parse_seconds = std::chrono::duration<double>(parsed - start).count();
+            stats->total_seconds = std::chrono::duration<double>(clock::now() - start).count();
+            stats->wait_seconds = 0;
+        }
+        return;
+    }
+
+    // Chunks wait on each other's watermarks, so every chunk needs a thread of its own:
+    // run them on pool workers (a private pool when none is given), one chunk each.
+    // parallel_ranges without a pool may fall back to running ranges one after another.
+    std::unique_ptr<ThreadPool> own_pool;
+    if (!pool)
+    {
+        own_pool = std::make_unique<ThreadPool>(static_cast<int>(resolve_thread_count(threads_count, T_rows)));
+        pool = own_pool.get();
+    }
+    MappedFile file(T_file);
+    int num_chunks = static_cast<int>(resolve_thread_count(threads_count, T_rows, pool));
+    std::vector<ParseChunk> chunks = split_text_chunks(file.data, file.data + file.size, num_chunks, threads_count, pool);
+    int rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().lines;
+    if (rows != T_rows)
+    {
+        throw std::runtime_error("Array dimensions do not match filename: " + T_file);
+    }
+    num_chunks = chunks.size();
+
+    Matrix parsed(T_rows, T_cols, width);
+    RowWatermark watermark(chunks);
+    std::vector<int> S_values = S.to_vector();
+    const int S_rows = S.rows();
+    const int max_i = T_rows - S_rows + 1;
+    ComputeThreadData proto = kernel_thread_data(parsed, S_values, S_rows, S.cols(), metric);
+    std::vector<ComputeThreadData> thread_data(num_chunks, proto);
+    std::vector<double> parse_done(num_chunks, 0.0), waits(num_chunks, 0.0);
+    // Output rows of chunk c: [first_row, min(first_row + lines, max_i)); next[c] is the first not yet scored
+    std::vector<int> next(num_chunks);
+    auto band_end = [&](int c)
+    { return std::min(chunks[c].first_row + chunks[c].lines, max_i); };
+    auto score = [&](ComputeThreadData &data, int c, int end_i)
+    {
+        if (end_i > next[c])
+        {
+            data.start_i = next[c];
+            data.end_i = end_i;
+            data.kernel(&data);
+            next[c] = end_i;
+        }
+    };
+
+    parallel_ranges(
+        num_chunks, num_chunks,
+        [&](int t, int begin, int end)
+        {
+            ComputeThreadData &data = thread_data[t];
+            // 先解析自己的區塊，邊解析邊計算已就緒的列
+            for (int c = begin; c < end; ++c)
+            {
+                next[c] = chunks[c].first_row;
+                parse_chunk(chunks[c], parsed, T_cols,
+                            [&](int rows_parsed)
+                            {
+                                watermark.publish(c, rows_parsed);
+                                score(data, c, std::min(band_end(c), chunks[c].first_row + rows_parsed - S_rows + 1));
+                            });
+                parse_done[c] = std::chrono::duration<double>(clock::now() - start).count();
+                if (!chunks[c].error.empty())
+                {
+                    watermark.fail();
+                    return;
+                }
+            }
+            // 區塊尾端需要下一個區塊的前 S_rows - 1 列
+            for (int c = begin; c < end; ++c)
+            {
+                if (next[c] < band_end(c))
+                {
+                    auto wait_start = clock::now();
+                    if (!watermark.wait_rows(next[c], band_end(c) + S_rows - 1))
+                    {
+                        return;
+                    }
+                    waits[c] += std::chrono::duration<double>(clock::now() - wait_start).count();
+                    score(data, c, band_end(c));
+                }
+            }
+        },
+        pool);
+    check_chunks(chunks, T_file);
+
+    // 合併結果
+    best_value = proto.local_best_value;
+    best_positions.clear();
+    for (const auto &data : thread_data)
+    {
+        merge_best(data.local_best_value, data.local_best_positions, proto.find_max, best_value, best_positions);
+    }
+    std::sort(best_positions.begin(), best_positions.end());
+    T = std::move(parsed);
+
+    if (stats)
+    {
+        stats->parse_seconds = *std::max_element(parse_done.begin(), parse_done.end());
+        stats->total_seconds = std::chrono::duration<double>(clock::now() - start).count();
+        stats->wait_seconds = std::accumulate(waits.begin(), waits.end(), 0.0);
+    }
+}
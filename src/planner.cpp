@@ -0,0 +1,293 @@
+#include "planner.hpp"
+#include "matcher.hpp"
+#include "utils.hpp"
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+
+namespace
+{
+    // Multiply-adds in the probe band: long enough to time (~10 ms on one core),
+    // short enough that the whole probe stays around a second
+    constexpr double probe_work = 1 << 24;
+
+    // The first rows of T as a matrix of its own (with its zeroed tail)
+    Matrix leading_rows(const Matrix &T, int rows)
+    {
+        Matrix band(rows, T.cols(), T.width());
+        std::memcpy(band.row_bytes(0), T.row_bytes(0), T.stride() * rows);
+        return band;
+    }
+
+    // Fastest of `repetitions` runs after one warm-up
+    double time_plan(const Plan &plan, Metric metric, const Matrix &S, const Matrix &T, ThreadPool &pool,
+                     int repetitions)
+    {
+        std::vector<std::pair<int, int>> positions;
+        double value;
+        run_plan(plan, metric, S, T, positions, value, &pool);
+        double best = std::numeric_limits<double>::max();
+        for (int rep = 0; rep < repetitions; ++rep)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run_plan(plan, metric, S, T, positions, value, &pool);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+        return best;
+    }
+
+    // Engines whose results equal compute() for this metric
+    std::vector<Engine> candidate_engines(Metric metric)
+    {
+        std::vector<Engine> engines = {Engine::Direct};
+        if (metric == Metric::PCC || metric == Metric::SSD)
+        {
+            engines.insert(engines.end(), {Engine::SIMD, Engine::Integral, Engine::FFT, Engine::Pyramid});
+        }
+        if (metric == Metric::SSD)
+        {
+            engines.push_back(Engine::BranchBound);
+        }
+        return engines;
+    }
+
+    // 1, 2, 4, ... and max_threads itself
+    std::vector<int> candidate_threads(int max_threads)
+    {
+        std::vector<int> threads;
+        for (int t = 1; t < max_threads; t *= 2)
+        {
+            threads.push_back(t);
+        }
+        threads.push_back(max_threads);
+        return threads;
+    }
+
+    std::map<std::string, Plan> read_tuning_file(const std::string &filename)
+    {
+        std::map<std::string, Plan> plans;
+        std::ifstream in(filename);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            // metric S T storage cores | engine threads tile_rows tile_cols predicted
+            std::istringstream fields(line);
+            std::string key[5], engine;
+            Plan plan;
+            if (!(fields >> key[0] >> key[1] >> key[2] >> key[3] >> key[4] >> engine >> plan.threads >>
+                  plan.tile_rows >> plan.tile_cols >> plan.predicted_seconds))
+            {
+                continue; // tolerate hand edits
+            }
+            try
+            {
+                plan.engine = parse_engine(engine);
+            }
+            catch (const std::runtime_error &)
+            {
+                continue;
+            }
+            plan.cached = true;
+            plans[key[0] + " " + key[1] + " " + key[2] + " " + key[3] + " " + key[4]] = plan;
+        }
+        return plans;
+    }
+
+    void write_tuning_file(const std::string &filename, const std::map<std::string, Plan> &plans)
+    {
+        std::string tmp = filename + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open())
+            {
+                throw std::runtime_error("Failed to open file for writing: " + tmp);
+            }
+            out << "# metric S T storage cores | engine threads tile_rows tile_cols predicted_seconds\n";
+            for (const auto &[key, plan] : plans)
+            {
+                out << key << " " << engine_option(plan.engine) << " " << plan.threads << " " << plan.tile_rows << " "
+                    << plan.tile_cols << " " << plan.predicted_seconds << "\n";
+            }
+            if (!out)
+            {
+                throw std::runtime_error("Failed to write file: " + tmp);
+            }
+        }
+        fs::rename(tmp, filename);
+    }
+}
+
+std::string plan_key(Metric metric, const Matrix &S, const Matrix &T, int cores)
+{
+    std::ostringstream key;
+    key << metric_name(metric) << " " << S.rows() << "x" << S.cols() << " " << T.rows() << "x" << T.cols() << " "
+        << element_width_name(T.width()) << " " << cores;
+    return key.str();
+}
+
+std::string describe_plan(const Plan &plan)
+{
+    std::ostringstream out;
+    out << engine_option(plan.engine) << ", " << plan.threads << " thread" << (plan.threads > 1 ? "s" : "");
+    if (plan.engine == Engine::Direct)
+    {
+        if (plan.tile_rows > 0 || plan.tile_cols > 0)
+        {
+            out << ", " << plan.tile_rows << "x" << plan.tile_cols << " tiles";
+        }
+        else
+        {
+            out << ", default tiles";
+        }
+    }
+    return out.str();
+}
+
+void run_plan(const Plan &plan, Metric metric, const Matrix &S, const Matrix &T,
+              std::vector<std::pair<int, int>> &best_positions, double &best_value, ThreadPool *pool)
+{
+    if (plan.engine != Engine::Direct)
+    {
+        run_engine(plan.engine, metric, S, T, best_positions, best_value, plan.threads, pool);
+        return;
+    }
+    MatchOptions options;
+    options.threads = plan.threads;
+    options.pool = pool;
+    options.tile_rows = plan.tile_rows;
+    options.tile_cols = plan.tile_cols;
+    MatchResult result = Matcher(S, metric).match(T, options);
+    best_value = result.best_value;
+    best_positions = std::move(result.best_positions);
+}
+
+Plan plan_match(const Matrix &S, const Matrix &T, Metric metric, ThreadPool &pool, const PlannerOptions &options)
+{
+    validate_dimensions(S, T);
+    const int max_i = T.rows() - S.rows() + 1;
+    const int max_j = T.cols() - S.cols() + 1;
+    const int cores = pool.size();
+    const std::string key = plan_key(metric, S, T, cores);
+
+    std::map<std::string, Plan> plans;
+    if (!options.tuning_file.empty())
+    {
+        plans = read_tuning_file(options.tuning_file);
+        auto it = plans.find(key);
+        if (!options.retune && it != plans.end())
+        {
+            return it->second;
+        }
+    }
+
+    // 探測: T 的前幾列（至少讓每個 worker 分到幾列）與只有一列輸出的 stub
+    const double row_work = static_cast<double>(max_j) * S.rows() * S.cols();
+    const int min_rows = std::min(max_i, 4 * cores);
+    const int probe_rows = std::clamp(static_cast<int>(probe_work / row_work), min_rows, max_i);
+    const Matrix band = probe_rows == max_i ? T : leading_rows(T, probe_rows + S.rows() - 1);
+    const Matrix stub = leading_rows(T, S.rows());
+
+    // Linear in output rows: t(rows) = t(1) + per_row * (rows - 1), so a probe of the
+    // whole T (probe_rows == max_i) predicts exactly what it measured
+    auto predict = [&](const Plan &plan, double &band_seconds)
+    {
+        band_seconds = time_plan(plan, metric, S, band, pool, options.repetitions);
+        if (probe_rows == max_i)
+        {
+            return band_seconds;
+        }
+        double stub_seconds = time_plan(plan, metric, S, stub, pool, options.repetitions);
+        double per_row = std::max(band_seconds - stub_seconds, 0.0) / (probe_rows - 1);
+        return stub_seconds + per_row * (max_i - 1);
+    };
+    auto report = [&](const Plan &plan)
+    {
+        if (options.verbose)
+        {
+            std::cout << "  probe " << describe_plan(plan) << ": predicted " << plan.predicted_seconds * 1e3
+                      << " ms\n";
+        }
+    };
+    if (options.verbose)
+    {
+        std::cout << "Tuning " << key << " on " << probe_rows << " of " << max_i << " output rows\n";
+    }
+
+    // 1. 單執行緒比較各引擎
+    std::vector<Plan> single;
+    double band_seconds;
+    for (Engine engine : candidate_engines(metric))
+    {
+        Plan plan;
+        plan.engine = engine;
+        plan.predicted_seconds = predict(plan, band_seconds);
+        report(plan);
+        single.push_back(plan);
+    }
+    double best_single = std::numeric_limits<double>::max();
+    for (const auto &plan : single)
+    {
+        best_single = std::min(best_single, plan.predicted_seconds);
+    }
+
+    // 2. Thread counts for the engines within 2x of the best: they scale differently
+    Plan best;
+    best.predicted_seconds = std::numeric_limits<double>::max();
+    const int max_threads = std::max(1, std::min(cores, max_i));
+    for (const auto &base : single)
+    {
+        if (base.predicted_seconds > 2 * best_single)
+        {
+            continue;
+        }
+        for (int threads : candidate_threads(max_threads))
+        {
+            Plan plan = base;
+            plan.threads = threads;
+            if (threads > 1)
+            {
+                plan.predicted_seconds = predict(plan, band_seconds);
+                report(plan);
+            }
+            if (plan.predicted_seconds < best.predicted_seconds)
+            {
+                best = plan;
+            }
+        }
+    }
+
+    // 3. Tile shape of the direct engine at the chosen thread count, as a ratio of
+    // band times against the default shape
+    if (best.engine == Engine::Direct)
+    {
+        double default_seconds = time_plan(best, metric, S, band, pool, options.repetitions);
+        const Plan chosen = best;
+        for (auto [rows, cols] : {std::make_pair(8, 1024), std::make_pair(16, 256), std::make_pair(32, 512),
+                                  std::make_pair(64, 128)})
+        {
+            Plan plan = chosen;
+            plan.tile_rows = rows;
+            plan.tile_cols = cols;
+            double seconds = time_plan(plan, metric, S, band, pool, options.repetitions);
+            plan.predicted_seconds = chosen.predicted_seconds * seconds / std::max(default_seconds, 1e-9);
+            report(plan);
+            if (plan.predicted_seconds < best.predicted_seconds)
+            {
+                best = plan;
+            }
+        }
+    }
+
+    if (!options.tuning_file.empty())
+    {
+        plans[key] = best;
+        write_tuning_file(options.tuning_file, plans);
+    }
+    return best;
+}
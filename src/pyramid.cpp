@@ -0,0 +1,341 @@
+#include "pyramid.hpp"
+#include "integral.hpp"
+#include "kernel.hpp"
+#include <algorithm>
+
+namespace
+{
+    // PCC bounds are real-valued; only prune when the bound misses by more than
+    // rounding could explain (well above the 1e-10 tie epsilon)
+    constexpr double pcc_margin = 1e-9;
+    constexpr int finest_block = 4;
+
+    struct BlockLevel
+    {
+        int block, block_rows, block_cols;
+        std::vector<long long> S_sums;      // SSD: raw template block sums
+        std::vector<double> S_normalised;   // PCC: centred, unit-norm template block sums
+    };
+
+    struct PyramidContext
+    {
+        const IntegralImage *image;
+        const Matrix *T; // uint8
+        const std::vector<int> *S;
+        int S_rows, S_cols;
+        long long n, sum_S, sum_sq_S;
+        double S_norm; // ||S - mean(S)||
+        bool find_max;
+    };
+
+    // Incumbent the bounds are tested against: best full score found so far
+    struct Incumbent
+    {
+        long long ssd;
+        double pcc;
+    };
+
+    double full_score(const PyramidContext &ctx, int i, int j)
+    {
+        const uint8_t *window = ctx.T->row<uint8_t>(i) + j;
+        if (ctx.find_max)
+        {
+            return window_score<PCCKernel, 0, 0>(window, ctx.T->stride(), ctx.S->data(), ctx.S_rows, ctx.S_cols);
+        }
+        return window_score<SSDKernel, 0, 0>(window, ctx.T->stride(), ctx.S->data(), ctx.S_rows, ctx.S_cols);
+    }
+
+    // Bound of the window at (i, j) on this level: an SSD lower bound or a PCC upper
+    // bound. `prune` is set when the bound cannot reach the incumbent.
+    double level_bound(const PyramidContext &ctx, const BlockLevel &level, int i, int j,
+                       const Incumbent &incumbent, bool &prune)
+    {
+        const int b = level.block;
+        if (!ctx.find_max)
+        {
+            long long scaled = 0; // b² · Σ (X_B - Y_B)² / b²
+            for (int br = 0; br < level.block_rows; ++br)
+            {
+                for (int bc = 0; bc < level.block_cols; ++bc)
+                {
+                    long long d = static_cast<long long>(ctx.image->window_sum(i + br * b, j + bc * b, b, b)) -
+                                  level.S_sums[br * level.block_cols + bc];
+                    scaled += d * d;
+                }
+            }
+            // 整數比較，保持精確（floor 只會讓剪枝更保守）
+            prune = scaled / (b * b) > incumbent.ssd;
+            return static_cast<double>(scaled) / (b * b);
+        }
+
+        long long sum_T = ctx.image->window_sum(i, j, ctx.S_rows, ctx.S_cols);
+        long long sum_sq_T = ctx.image->window_sum_sq(i, j, ctx.S_rows, ctx.S_cols);
+        long long var_T = ctx.n * sum_sq_T - sum_T * sum_T; // n · ||T - mean(T)||²
+        if (var_T == 0 || ctx.S_norm == 0.0)
+        {
+            prune = 0.0 < incumbent.pcc - pcc_margin; // PCC is exactly 0 here
+            return 0.0;
+        }
+        const double T_norm = std::sqrt(static_cast<double>(var_T) / ctx.n);
+        const double block_mean = static_cast<double>(sum_T) * b * b / ctx.n;
+        double distance = 0.0; // lower bound on ||T̃ - S̃||²
+        for (int br = 0; br < level.block_rows; ++br)
+        {
+            for (int bc = 0; bc < level.block_cols; ++bc)
+            {
+                double x = (ctx.image->window_sum(i + br * b, j + bc * b, b, b) - block_mean) / T_norm;
+                double d = x - level.S_normalised[br * level.block_cols + bc];
+                distance += d * d;
+            }
+        }
+        // PCC = 1 - ||T̃ - S̃||² / 2 for centred unit-norm vectors
+        double bound = 1.0 - distance / (2.0 * b * b);
+        prune = bound < incumbent.pcc - pcc_margin;
+        return bound;
+    }
+
+    void improve(Incumbent &incumbent, double score, bool find_max)
+    {
+        if (find_max)
+        {
+            incumbent.pcc = std::max(incumbent.pcc, score);
+        }
+        else
+        {
+            incumbent.ssd = std::min(incumbent.ssd, static_cast<long long>(score));
+        }
+    }
+
+    // Best bound seen by one thread, to refine the incumbent with
+    struct BestBound
+    {
+        double bound;
+        int i = -1, j = -1;
+    };
+}
+
+void compute_pyramid(const Matrix &S_matrix, const Matrix &T_matrix, Metric metric,
+                     std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                     ThreadPool *pool, PyramidStats *stats)
+{
+    validate_dimensions(S_matrix, T_matrix);
+    require_pcc_or_ssd(metric, "pyramid");
+    const int S_rows = S_matrix.rows(), S_cols = S_matrix.cols();
+    const int max_i = T_matrix.rows() - S_rows + 1;
+    const int max_j = T_matrix.cols() - S_cols + 1;
+    std::vector<int> S = S_matrix.to_vector();
+    Matrix T = T_matrix.as_width(ElementWidth::UInt8);
+
+    IntegralImage image;
+    build_integral_image(T, image, threads_count, pool);
+
+    PyramidContext ctx;
+    ctx.image = &image;
+    ctx.T = &T;
+    ctx.S = &S;
+    ctx.S_rows = S_rows;
+    ctx.S_cols = S_cols;
+    ctx.n = static_cast<long long>(S_rows) * S_cols;
+    ctx.sum_S = 0;
+    ctx.sum_sq_S = 0;
+    for (int v : S)
+    {
+        ctx.sum_S += v;
+        ctx.sum_sq_S += v * v;
+    }
+    ctx.S_norm = std::sqrt(static_cast<double>(ctx.n * ctx.sum_sq_S - ctx.sum_S * ctx.sum_S) / ctx.n);
+    ctx.find_max = metric_find_max(metric);
+
+    // 建立模板金字塔：區塊邊長由粗到細
+    std::vector<BlockLevel> levels;
+    int coarsest = finest_block;
+    while (coarsest * 4 <= std::min(S_rows, S_cols))
+    {
+        coarsest *= 2;
+    }
+    for (int b = coarsest; b >= finest_block && 2 * b <= std::min(S_rows, S_cols); b /= 2)
+    {
+        BlockLevel level;
+        level.block = b;
+        level.block_rows = S_rows / b;
+        level.block_cols = S_cols / b;
+        const double block_mean = static_cast<double>(ctx.sum_S) * b * b / ctx.n;
+        for (int br = 0; br < level.block_rows; ++br)
+        {
+            for (int bc = 0; bc < level.block_cols; ++bc)
+            {
+                long long sum = 0;
+                for (int k = 0; k < b; ++k)
+                {
+                    for (int l = 0; l < b; ++l)
+                    {
+                        sum += S[(br * b + k) * S_cols + bc * b + l];
+                    }
+                }
+                level.S_sums.push_back(sum);
+                level.S_normalised.push_back(ctx.S_norm > 0.0 ? (sum - block_mean) / ctx.S_norm : 0.0);
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+
+    size_t num_threads = resolve_thread_count(threads_count, max_i, pool);
+    auto better = [&](double a, double b)
+    { return ctx.find_max ? a > b : a < b; };
+    const double worst = ctx.find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    Incumbent incumbent{std::numeric_limits<long long>::max(), -std::numeric_limits<double>::max()};
+
+    std::vector<std::vector<std::pair<int, int>>> survivors(num_threads);
+    PyramidStats local_stats;
+    local_stats.positions = static_cast<long long>(max_i) * max_j;
+
+    if (!levels.empty())
+    {
+        // Seed the incumbent with the full score of each band's most promising window
+        std::vector<BestBound> seeds(num_threads, BestBound{worst});
+        Incumbent open = incumbent;
+        parallel_ranges(
+            max_i, num_threads,
+            [&](int t, int start_i, int end_i)
+            {
+                bool prune;
+                for (int i = start_i; i < end_i; ++i)
+                {
+                    for (int j = 0; j < max_j; ++j)
+                    {
+                        double bound = level_bound(ctx, levels[0], i, j, open, prune);
+                        if (better(bound, seeds[t].bound))
+                        {
+                            seeds[t] = {bound, i, j};
+                        }
+                    }
+                }
+            },
+            pool);
+        for (const auto &seed : seeds)
+        {
+            if (seed.i >= 0)
+            {
+                improve(incumbent, full_score(ctx, seed.i, seed.j), ctx.find_max);
+            }
+        }
+    }
+
+    // 由粗到細逐層剪枝
+    std::vector<std::pair<int, int>> candidates;
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        const BlockLevel &level = levels[l];
+        std::vector<BestBound> best_bounds(num_threads, BestBound{worst});
+        long long count = l == 0 ? local_stats.positions : static_cast<long long>(candidates.size());
+        auto visit = [&](int t, int i, int j)
+        {
+            bool prune;
+            double bound = level_bound(ctx, level, i, j, incumbent, prune);
+            if (!prune)
+            {
+                survivors[t].push_back({i, j});
+                if (better(bound, best_bounds[t].bound))
+                {
+                    best_bounds[t] = {bound, i, j};
+                }
+            }
+        };
+        if (l == 0)
+        {
+            parallel_ranges(
+                max_i, num_threads,
+                [&](int t, int start_i, int end_i)
+                {
+                    for (int i = start_i; i < end_i; ++i)
+                    {
+                        for (int j = 0; j < max_j; ++j)
+                        {
+                            visit(t, i, j);
+                        }
+                    }
+                },
+                pool);
+        }
+        else
+        {
+            parallel_ranges(
+                candidates.size(), num_threads,
+                [&](int t, int begin, int end)
+                {
+                    for (int k = begin; k < end; ++k)
+                    {
+                        visit(t, candidates[k].first, candidates[k].second);
+                    }
+                },
+                pool);
+        }
+
+        candidates.clear();
+        for (auto &part : survivors)
+        {
+            candidates.insert(candidates.end(), part.begin(), part.end());
+            part.clear();
+        }
+        local_stats.levels.push_back({level.block, count, static_cast<long long>(candidates.size())});
+        // The tightest bound on this level is the likeliest winner: let it tighten the incumbent
+        for (const auto &best : best_bounds)
+        {
+            if (best.i >= 0)
+            {
+                improve(incumbent, full_score(ctx, best.i, best.j), ctx.find_max);
+            }
+        }
+    }
+
+    // 全解析度計算倖存位置
+    std::vector<LocalBest> locals(num_threads, LocalBest{worst, {}});
+    auto score = [&](int t, int i, int j)
+    {
+        update_best(full_score(ctx, i, j), i, j, ctx.find_max, locals[t].value, locals[t].positions);
+    };
+    if (levels.empty())
+    {
+        parallel_ranges(
+            max_i, num_threads,
+            [&](int t, int start_i, int end_i)
+            {
+                for (int i = start_i; i < end_i; ++i)
+                {
+                    for (int j = 0; j < max_j; ++j)
+                    {
+                        score(t, i, j);
+                    }
+                }
+            },
+            pool);
+        local_stats.full_scored = local_stats.positions;
+    }
+    else
+    {
+        parallel_ranges(
+            candidates.size(), num_threads,
+            [&](int t, int begin, int end)
+            {
+                for (int k = begin; k < end; ++k)
+                {
+                    score(t, candidates[k].first, candidates[k].second);
+                }
+            },
+            pool);
+        local_stats.full_scored = candidates.size();
+    }
+
+    // 合併結果
+    best_value = worst;
+    best_positions.clear();
+    for (const auto &local : locals)
+    {
+        merge_best(local.value, local.positions, ctx.find_max, best_value, best_positions);
+    }
+    std::sort(best_positions.begin(), best_positions.end());
+    if (stats)
+    {
+        *stats = std::move(local_stats);
+    }
+}
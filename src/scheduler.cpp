@@ -0,0 +1,188 @@
+#include "scheduler.hpp"
+#include "compute.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+static size_t l2_cache_bytes()
+{
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return size > 0 ? static_cast<size_t>(size) : 256 * 1024;
+}
+
+std::vector<Tile> make_tiles(int max_i, int max_j, int S_rows, int S_cols, ElementWidth width, int num_workers,
+                             int fixed_rows, int fixed_cols)
+{
+    std::vector<Tile> tiles;
+    if (max_i <= 0 || max_j <= 0)
+    {
+        return tiles;
+    }
+
+    // Kernels read nibble rows unpacked to bytes
+    const size_t pixel_bytes = width == ElementWidth::Int32 ? sizeof(int32_t) : 1;
+    const size_t budget = l2_cache_bytes() / 2;
+    int tile_cols = std::min(max_j, fixed_cols > 0 ? fixed_cols : 512);
+    size_t row_bytes = (tile_cols + S_cols - 1) * pixel_bytes;
+    int tile_rows = fixed_rows > 0 ? fixed_rows : static_cast<int>(budget / row_bytes) - (S_rows - 1);
+    tile_rows = std::clamp(tile_rows, 1, max_i);
+
+    // 至少每個 worker 分到幾塊，才有東西可偷
+    const size_t min_tiles = 4 * static_cast<size_t>(std::max(num_workers, 1));
+    auto count = [&]
+    {
+        return static_cast<size_t>((max_i + tile_rows - 1) / tile_rows) * ((max_j + tile_cols - 1) / tile_cols);
+    };
+    while (count() < min_tiles && ((tile_rows > 1 && fixed_rows <= 0) || (tile_cols > 64 && fixed_cols <= 0)))
+    {
+        if (tile_rows > 1 && fixed_rows <= 0)
+        {
+            tile_rows = (tile_rows + 1) / 2;
+        }
+        else
+        {
+            tile_cols = (tile_cols + 1) / 2;
+        }
+    }
+
+    tiles.reserve(count());
+    for (int i = 0; i < max_i; i += tile_rows)
+    {
+        for (int j = 0; j < max_j; j += tile_cols)
+        {
+            tiles.push_back({i, std::min(i + tile_rows, max_i), j, std::min(j + tile_cols, max_j)});
+        }
+    }
+    return tiles;
+}
+
+namespace
+{
+    struct alignas(64) TileQueue
+    {
+        std::mutex mutex;
+        std::deque<int> tiles;
+    };
+}
+
+void run_tiles(const std::vector<Tile> &tiles, int num_workers,
+               const std::function<void(int, const Tile &)> &body,
+               SchedulerStats *stats, ThreadPool *pool, RunTrace *trace)
+{
+    const int count = static_cast<int>(tiles.size());
+    num_workers = std::max(1, std::min(num_workers, count));
+    std::vector<TileQueue> queues(num_workers);
+    std::vector<int> tiles_run(num_workers, 0), steals(num_workers, 0);
+
+    // 相鄰的 tile 先分給同一個 worker，共用 T 的列
+    int block = count / num_workers;
+    for (int w = 0; w < num_workers; ++w)
+    {
+        int end = (w == num_workers - 1) ? count : (w + 1) * block;
+        for (int k = w * block; k < end; ++k)
+        {
+            queues[w].tiles.push_back(k);
+        }
+    }
+
+    auto pop_own = [&](int w, int &tile)
+    {
+        std::lock_guard<std::mutex> lock(queues[w].mutex);
+        if (queues[w].tiles.empty())
+        {
+            return false;
+        }
+        tile = queues[w].tiles.front();
+        queues[w].tiles.pop_front();
+        return true;
+    };
+    auto steal = [&](int w, int &tile)
+    {
+        for (int k = 1; k < num_workers; ++k)
+        {
+            TileQueue &victim = queues[(w + k) % num_workers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tiles.empty())
+            {
+                tile = victim.tiles.back();
+                victim.tiles.pop_back();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (trace)
+    {
+        trace->workers.assign(num_workers, WorkerTrace());
+    }
+    // Untraced runs only pay the null test
+    auto run = [&](int w, int tile)
+    {
+        if (!trace)
+        {
+            body(w, tiles[tile]);
+            return;
+        }
+        double begin = trace->now();
+        body(w, tiles[tile]);
+        double end = trace->now();
+        WorkerTrace &worker = trace->workers[w];
+        const Tile &t = tiles[tile];
+        worker.busy += end - begin;
+        worker.tiles++;
+        worker.windows += static_cast<long long>(t.i1 - t.i0) * (t.j1 - t.j0);
+        worker.spans.push_back({begin, end});
+    };
+
+    parallel_ranges(
+        num_workers, num_workers,
+        [&](int, int begin, int end)
+        {
+            for (int w = begin; w < end; ++w)
+            {
+                std::unique_ptr<PerfCounters> counters;
+                if (trace)
+                {
+                    if (trace->counters)
+                    {
+                        counters = std::make_unique<PerfCounters>();
+                    }
+                    trace->workers[w].start = trace->now();
+                }
+                // Counted locally and published once: neighbouring slots share cache lines
+                int tile, own = 0, stolen = 0;
+                while (pop_own(w, tile))
+                {
+                    run(w, tile);
+                    own++;
+                }
+                // Nothing refills a deque, so one empty sweep means all work is claimed
+                while (steal(w, tile))
+                {
+                    run(w, tile);
+                    stolen++;
+                }
+                tiles_run[w] = own + stolen;
+                steals[w] = stolen;
+                if (trace)
+                {
+                    trace->workers[w].end = trace->now();
+                    if (counters)
+                    {
+                        counters->read(trace->workers[w]);
+                    }
+                }
+            }
+        },
+        pool);
+
+    if (stats)
+    {
+        stats->tiles_run = std::move(tiles_run);
+        stats->steals = std::move(steals);
+    }
+}
@@ -0,0 +1,612 @@
+#include "server.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "matcher.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint32_t max_scene_bytes = 4096;
+    constexpr int64_t max_template_pixels = 1 << 24;
+
+    bool read_full(int fd, void *buffer, size_t size)
+    {
+        char *p = static_cast<char *>(buffer);
+        while (size > 0)
+        {
+            ssize_t n = recv(fd, p, size, 0);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool write_full(int fd, const void *buffer, size_t size)
+    {
+        const char *p = static_cast<const char *>(buffer);
+        while (size > 0)
+        {
+            ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    sockaddr_un socket_address(const std::string &path)
+    {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Invalid socket path: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return address;
+    }
+
+    int connect_socket(const std::string &path)
+    {
+        sockaddr_un address = socket_address(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not create socket");
+        }
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // One queued request and, once its batch ran, its reply
+    struct Pending
+    {
+        RequestHeader header;
+        std::string scene;
+        std::vector<uint8_t> pixels;
+        Clock::time_point received;
+
+        ReplyHeader reply;
+        std::vector<WirePosition> positions;
+        std::string message;
+        Latch done{1};
+    };
+
+    struct Connection
+    {
+        int fd;
+        pthread_t thread;
+        std::atomic<bool> finished{false};
+        struct ServerState *state;
+    };
+
+    struct ServerState
+    {
+        const std::vector<Scene> *scenes;
+        std::map<std::string, int> scene_index;
+        ThreadPool *pool;
+        ServerOptions options;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Pending *> queue;
+        bool stopping = false;
+
+        // dispatcher only
+        std::vector<double> latencies_ms;
+        long long batches = 0;
+    };
+
+    volatile sig_atomic_t signalled = 0;
+
+    void on_signal(int)
+    {
+        signalled = 1;
+    }
+
+    void fail(Pending &request, const std::string &message)
+    {
+        request.reply.status = 1;
+        request.message = message;
+    }
+
+    void reply_to(int fd, const Pending &request)
+    {
+        ReplyHeader header = request.reply;
+        header.magic = match_reply_magic;
+        header.count = request.positions.size();
+        header.message_bytes = request.message.size();
+        std::vector<char> buffer(sizeof(header) + header.count * sizeof(WirePosition) + header.message_bytes);
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        std::memcpy(buffer.data() + sizeof(header), request.positions.data(), header.count * sizeof(WirePosition));
+        std::memcpy(buffer.data() + sizeof(header) + header.count * sizeof(WirePosition), request.message.data(),
+                    header.message_bytes);
+        write_full(fd, buffer.data(), buffer.size());
+    }
+
+    void *connection_main(void *arg)
+    {
+        Connection *connection = static_cast<Connection *>(arg);
+        ServerState &state = *connection->state;
+        const int fd = connection->fd;
+        while (true)
+        {
+            auto request = std::make_unique<Pending>();
+            std::memset(&request->reply, 0, sizeof(request->reply));
+            if (!read_full(fd, &request->header, sizeof(RequestHeader)) ||
+                request->header.magic != match_request_magic)
+            {
+                break; // closed, or out of sync with the stream
+            }
+            const RequestHeader &header = request->header;
+            if (header.op == static_cast<uint16_t>(ServerOp::Shutdown))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    state.stopping = true;
+                }
+                state.cv.notify_all();
+                reply_to(fd, *request);
+                break;
+            }
+            const int64_t pixels = static_cast<int64_t>(header.s_rows) * header.s_cols;
+            if (header.s_rows <= 0 || header.s_cols <= 0 || pixels > max_template_pixels ||
+                header.scene_bytes > max_scene_bytes)
+            {
+                break; // cannot skip a payload of unknown size
+            }
+            request->scene.resize(header.scene_bytes);
+            request->pixels.resize(pixels);
+            if (!read_full(fd, request->scene.data(), header.scene_bytes) ||
+                !read_full(fd, request->pixels.data(), pixels))
+            {
+                break;
+            }
+            request->received = Clock::now();
+
+            bool queued = false;
+            if (header.op == static_cast<uint16_t>(ServerOp::Match))
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (!state.stopping)
+                {
+                    state.queue.push_back(request.get());
+                    queued = true;
+                }
+            }
+            if (queued)
+            {
+                state.cv.notify_all();
+                request->done.wait();
+            }
+            else
+            {
+                fail(*request, header.op == static_cast<uint16_t>(ServerOp::Match) ? "Server is shutting down"
+                                                                                    : "Unknown operation");
+            }
+            reply_to(fd, *request);
+        }
+        connection->finished = true;
+        return nullptr;
+    }
+
+    // Check one request against the scenes; on success scene receives its index
+    bool validate(ServerState &state, Pending &request, int &scene)
+    {
+        const RequestHeader &header = request.header;
+        auto it = state.scene_index.find(request.scene);
+        if (it == state.scene_index.end())
+        {
+            fail(request, "Unknown scene: " + request.scene);
+            return false;
+        }
+        scene = it->second;
+        const Matrix &T = (*state.scenes)[scene].T;
+        if (header.metric > static_cast<uint16_t>(Metric::NCC) ||
+            header.mode > static_cast<uint8_t>(ResultMode::Threshold))
+        {
+            fail(request, "Invalid metric or result mode");
+            return false;
+        }
+        if (header.s_rows > T.rows() || header.s_cols > T.cols())
+        {
+            fail(request, "Template is larger than scene " + request.scene);
+            return false;
+        }
+        // Threshold replies are capped at k as well, so one request cannot ask for every position
+        if (header.mode != static_cast<uint8_t>(ResultMode::Best) && header.k <= 0)
+        {
+            fail(request, "Top-K and threshold modes need k > 0");
+            return false;
+        }
+        // Kernels assume pixels 0-9, as read_array enforces for files
+        if (std::any_of(request.pixels.begin(), request.pixels.end(), [](uint8_t value)
+                        { return value > 9; }))
+        {
+            fail(request, "Template value out of range");
+            return false;
+        }
+        return true;
+    }
+
+    Matrix template_matrix(const Pending &request)
+    {
+        Matrix S(request.header.s_rows, request.header.s_cols, ElementWidth::UInt8);
+        for (int r = 0; r < S.rows(); ++r)
+        {
+            S.pack_row(r, request.pixels.data() + static_cast<size_t>(r) * S.cols());
+        }
+        return S;
+    }
+
+    void run_batch(ServerState &state, std::vector<Pending *> &batch)
+    {
+        const auto start = Clock::now();
+        const int threads = state.pool->size();
+
+        // 同一場景、同一指標的最佳值請求合併成一次 compute_batch
+        std::map<std::pair<int, int>, std::vector<Pending *>> groups;
+        std::vector<std::pair<int, Pending *>> ranked;
+        for (Pending *request : batch)
+        {
+            int scene;
+            if (!validate(state, *request, scene))
+            {
+                continue;
+            }
+            if (request->header.mode == static_cast<uint8_t>(ResultMode::Best))
+            {
+                groups[{scene, request->header.metric}].push_back(request);
+            }
+            else
+            {
+                ranked.push_back({scene, request});
+            }
+        }
+
+        auto elapsed_us = [](Clock::time_point from)
+        { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - from).count()); };
+        for (auto &[key, requests] : groups)
+        {
+            const Matrix &T = (*state.scenes)[key.first].T;
+            const Metric metric = static_cast<Metric>(key.second);
+            std::vector<BatchTemplate> templates;
+            for (Pending *request : requests)
+            {
+                templates.push_back(prepare_template(template_matrix(*request)));
+            }
+            auto pass_start = Clock::now();
+            std::vector<TemplateResult> results;
+            compute_batch(templates, T, metric, results, threads, state.pool);
+            uint64_t pass_us = elapsed_us(pass_start);
+            for (size_t k = 0; k < requests.size(); ++k)
+            {
+                requests[k]->reply.best_value = results[k].best_value;
+                requests[k]->reply.compute_us = pass_us;
+                for (const auto &[i, j] : results[k].best_positions)
+                {
+                    requests[k]->positions.push_back({i, j, results[k].best_value});
+                }
+            }
+        }
+        for (auto &[scene, request] : ranked)
+        {
+            const RequestHeader &header = request->header;
+            MatchOptions options;
+            options.results.mode = static_cast<ResultMode>(header.mode);
+            options.results.k = header.k;
+            options.results.threshold = header.threshold;
+            options.results.nms_radius = header.nms_radius;
+            options.threads = threads;
+            options.pool = state.pool;
+            auto pass_start = Clock::now();
+            try
+            {
+                MatchResult result = Matcher(template_matrix(*request), static_cast<Metric>(header.metric))
+                                         .match((*state.scenes)[scene].T, options);
+                request->reply.best_value = result.best_value;
+                for (const auto &position : result.ranked)
+                {
+                    request->positions.push_back({position.i, position.j, position.value});
+                }
+            }
+            catch (const std::exception &e)
+            {
+                fail(*request, e.what());
+            }
+            request->reply.compute_us = elapsed_us(pass_start);
+        }
+
+        const auto done = Clock::now();
+        for (Pending *request : batch)
+        {
+            request->reply.queue_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(start - request->received).count());
+            request->reply.batch_size = batch.size();
+            state.latencies_ms.push_back(std::chrono::duration<double, std::milli>(done - request->received).count());
+        }
+        ++state.batches;
+    }
+
+    void *dispatcher_main(void *arg)
+    {
+        ServerState &state = *static_cast<ServerState *>(arg);
+        const auto window = std::chrono::microseconds(state.options.batch_window_us);
+        const size_t max_batch = std::max(state.options.max_batch, 1);
+        while (true)
+        {
+            std::vector<Pending *> batch;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.cv.wait(lock, [&]
+                              { return !state.queue.empty() || state.stopping; });
+                if (state.queue.empty())
+                {
+                    return nullptr; // stopping and drained
+                }
+                // 等一小段時間收集更多請求
+                if (window.count() > 0)
+                {
+                    state.cv.wait_for(lock, window, [&]
+                                      { return state.queue.size() >= max_batch || state.stopping; });
+                }
+                while (!state.queue.empty() && batch.size() < max_batch)
+                {
+                    batch.push_back(state.queue.front());
+                    state.queue.pop_front();
+                }
+            }
+            try
+            {
+                run_batch(state, batch);
+            }
+            catch (const std::exception &e)
+            {
+                for (Pending *request : batch)
+                {
+                    fail(*request, e.what());
+                }
+            }
+            for (Pending *request : batch)
+            {
+                request->done.count_down();
+            }
+        }
+    }
+}
+
+MatchClient::MatchClient(const std::string &socket_path) : fd_(connect_socket(socket_path))
+{
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Could not connect to match server: " + socket_path);
+    }
+}
+
+MatchClient::~MatchClient()
+{
+    close(fd_);
+}
+
+MatchReply MatchClient::match(const MatchRequest &request)
+{
+    if (request.rows <= 0 || request.cols <= 0 ||
+        request.pixels.size() != static_cast<size_t>(request.rows) * request.cols)
+    {
+        throw std::invalid_argument("Template pixels do not match its dimensions");
+    }
+    RequestHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = match_request_magic;
+    header.op = static_cast<uint16_t>(ServerOp::Match);
+    header.metric = static_cast<uint16_t>(request.metric);
+    header.mode = static_cast<uint8_t>(request.results.mode);
+    header.k = request.results.k;
+    header.threshold = request.results.threshold;
+    header.nms_radius = request.results.nms_radius;
+    header.s_rows = request.rows;
+    header.s_cols = request.cols;
+    header.scene_bytes = request.scene.size();
+    std::vector<char> buffer(sizeof(header) + request.scene.size() + request.pixels.size());
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), request.scene.data(), request.scene.size());
+    std::memcpy(buffer.data() + sizeof(header) + request.scene.size(), request.pixels.data(), request.pixels.size());
+    ReplyHeader reply_header;
+    if (!write_full(fd_, buffer.data(), buffer.size()) || !read_full(fd_, &reply_header, sizeof(reply_header)) ||
+        reply_header.magic != match_reply_magic)
+    {
+        throw std::runtime_error("Match server closed the connection");
+    }
+
+    MatchReply reply;
+    std::vector<WirePosition> positions(reply_header.count);
+    reply.error.resize(reply_header.message_bytes);
+    if (!read_full(fd_, positions.data(), positions.size() * sizeof(WirePosition)) ||
+        !read_full(fd_, reply.error.data(), reply.error.size()))
+    {
+        throw std::runtime_error("Match server closed the connection");
+    }
+    reply.ok = reply_header.status == 0;
+    reply.best_value = reply_header.best_value;
+    for (const auto &p : positions)
+    {
+        reply.positions.push_back({p.value, p.i, p.j});
+    }
+    reply.queue_ms = reply_header.queue_us / 1e3;
+    reply.compute_ms = reply_header.compute_us / 1e3;
+    reply.batch_size = reply_header.batch_size;
+    return reply;
+}
+
+void MatchClient::shutdown_server()
+{
+    RequestHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = match_request_magic;
+    header.op = static_cast<uint16_t>(ServerOp::Shutdown);
+    ReplyHeader reply;
+    if (!write_full(fd_, &header, sizeof(header)) || !read_full(fd_, &reply, sizeof(reply)))
+    {
+        throw std::runtime_error("Match server closed the connection");
+    }
+}
+
+void serve(const std::vector<Scene> &scenes, ThreadPool &pool, const ServerOptions &options)
+{
+    ServerState state;
+    state.scenes = &scenes;
+    state.pool = &pool;
+    state.options = options;
+    for (size_t k = 0; k < scenes.size(); ++k)
+    {
+        if (!state.scene_index.emplace(scenes[k].name, static_cast<int>(k)).second)
+        {
+            throw std::invalid_argument("Duplicate scene name: " + scenes[k].name);
+        }
+    }
+
+    // A live server still answers on the path; a stale socket file is replaced
+    int probe = connect_socket(options.socket_path);
+    if (probe >= 0)
+    {
+        close(probe);
+        throw std::runtime_error("A server is already listening on " + options.socket_path);
+    }
+    unlink(options.socket_path.c_str());
+    sockaddr_un address = socket_address(options.socket_path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0)
+    {
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+        }
+        throw std::runtime_error("Could not listen on " + options.socket_path + ": " + std::strerror(errno));
+    }
+
+    struct sigaction action, old_int, old_term;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal; // no SA_RESTART, so poll() wakes up
+    signalled = 0;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    pthread_t dispatcher;
+    if (pthread_create(&dispatcher, nullptr, dispatcher_main, &state) != 0)
+    {
+        close(listen_fd);
+        throw std::runtime_error("Could not start the dispatcher thread");
+    }
+    std::cout << "Serving " << scenes.size() << " scene" << (scenes.size() > 1 ? "s" : "") << " on "
+              << options.socket_path << " with " << pool.size() << " workers\n"
+              << std::flush;
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    auto reap = [&](bool all)
+    {
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            if (all || (*it)->finished)
+            {
+                if (all)
+                {
+                    shutdown((*it)->fd, SHUT_RDWR); // wake a blocked read
+                }
+                pthread_join((*it)->thread, nullptr);
+                close((*it)->fd);
+                it = connections.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    };
+    while (!signalled)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.stopping)
+            {
+                break;
+            }
+        }
+        pollfd listener{listen_fd, POLLIN, 0};
+        if (poll(&listener, 1, 100) <= 0)
+        {
+            reap(false);
+            continue;
+        }
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->state = &state;
+        if (pthread_create(&connection->thread, nullptr, connection_main, connection.get()) != 0)
+        {
+            close(fd);
+            continue;
+        }
+        connections.push_back(std::move(connection));
+    }
+
+    // 停止: 先回答佇列中的請求，再關閉連線
+    close(listen_fd);
+    unlink(options.socket_path.c_str());
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stopping = true;
+    }
+    state.cv.notify_all();
+    pthread_join(dispatcher, nullptr);
+    reap(true);
+    sigaction(SIGINT, &old_int, nullptr);
+    sigaction(SIGTERM, &old_term, nullptr);
+
+    std::cout << "Served " << state.latencies_ms.size() << " requests in " << state.batches << " batches";
+    if (!state.latencies_ms.empty())
+    {
+        BenchStats stats = summarize_samples(state.latencies_ms);
+        std::cout << " (" << static_cast<double>(state.latencies_ms.size()) / state.batches
+                  << " per batch); latency ms: min " << stats.min << ", median " << stats.median << ", p95 "
+                  << stats.p95 << ", mean " << stats.mean;
+    }
+    std::cout << "\n";
+}
@@ -0,0 +1,295 @@
+#include "simd.hpp"
+#include "pcc.hpp"
+#include "ssd.hpp"
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+SimdLevel detect_simd_level()
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return SimdLevel::SSE41;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+const char *simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE41:
+        return "SSE4.1";
+    default:
+        return "scalar";
+    }
+}
+
+namespace
+{
+    // Positions scored per block; remainders fall back to the scalar block
+    constexpr int max_block = 16;
+
+    struct SimdContext
+    {
+        const uint8_t *T;
+        size_t T_stride;
+        int S_rows, S_cols;
+        const int *S;
+        std::vector<int16_t> S_pairs; // (S[k][l], S[k][l+1]) packed as s8 pairs, per row
+        int pairs_per_row;
+        int rows_per_flush; // rows that fit in an int16 accumulator
+        Metric metric;
+        long long sum_S, sum_sq_S;
+    };
+
+    struct BlockSums
+    {
+        int32_t sum_T[max_block];
+        int32_t sum_TT[max_block];
+        int32_t sum_ST[max_block];
+    };
+
+    void block_sums_scalar(const SimdContext &ctx, int i, int j, int count, BlockSums &out)
+    {
+        for (int p = 0; p < count; ++p)
+        {
+            int32_t sum_T = 0, sum_TT = 0, sum_ST = 0;
+            for (int k = 0; k < ctx.S_rows; ++k)
+            {
+                const uint8_t *t_row = ctx.T + (i + k) * ctx.T_stride + j + p;
+                const int *s_row = ctx.S + k * ctx.S_cols;
+                for (int l = 0; l < ctx.S_cols; ++l)
+                {
+                    int32_t x = t_row[l];
+                    sum_T += x;
+                    sum_TT += x * x;
+                    sum_ST += x * s_row[l];
+                }
+            }
+            out.sum_T[p] = sum_T;
+            out.sum_TT[p] = sum_TT;
+            out.sum_ST[p] = sum_ST;
+        }
+    }
+
+#ifdef SIMD_X86
+    // 16 positions: interleave T[j+l+p] with T[j+l+1+p] so pmaddubsw against the
+    // (S[l], S[l+1]) pair yields a two-tap partial sum per position
+    __attribute__((target("avx2"))) void block_sums_avx2(const SimdContext &ctx, int i, int j, BlockSums &out)
+    {
+        const __m256i ones = _mm256_set1_epi16(0x0101);
+        __m256i sum_T[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        __m256i sum_TT[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        __m256i sum_ST[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        __m256i acc_T = _mm256_setzero_si256();
+        __m256i acc_TT = _mm256_setzero_si256();
+        __m256i acc_ST = _mm256_setzero_si256();
+
+        for (int k = 0; k < ctx.S_rows; ++k)
+        {
+            const uint8_t *t_row = ctx.T + (i + k) * ctx.T_stride + j;
+            const int16_t *pairs = ctx.S_pairs.data() + k * ctx.pairs_per_row;
+            for (int p = 0; p < ctx.pairs_per_row; ++p)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(t_row + 2 * p));
+                __m128i b = _mm_loadu_si128((const __m128i *)(t_row + 2 * p + 1));
+                __m256i x = _mm256_set_m128i(_mm_unpackhi_epi8(a, b), _mm_unpacklo_epi8(a, b));
+                if (2 * p + 1 == ctx.S_cols)
+                {
+                    // Odd width: drop the partner pixel from the T statistics
+                    x = _mm256_and_si256(x, _mm256_set1_epi16(0x00ff));
+                }
+                acc_ST = _mm256_add_epi16(acc_ST, _mm256_maddubs_epi16(x, _mm256_set1_epi16(pairs[p])));
+                acc_T = _mm256_add_epi16(acc_T, _mm256_maddubs_epi16(x, ones));
+                acc_TT = _mm256_add_epi16(acc_TT, _mm256_maddubs_epi16(x, x));
+            }
+            if ((k + 1) % ctx.rows_per_flush == 0 || k + 1 == ctx.S_rows)
+            {
+                // Widen to int32 before the 16-bit lanes can overflow
+                __m256i *dst[3] = {sum_T, sum_TT, sum_ST};
+                __m256i *src[3] = {&acc_T, &acc_TT, &acc_ST};
+                for (int s = 0; s < 3; ++s)
+                {
+                    dst[s][0] = _mm256_add_epi32(dst[s][0], _mm256_cvtepi16_epi32(_mm256_castsi256_si128(*src[s])));
+                    dst[s][1] = _mm256_add_epi32(dst[s][1], _mm256_cvtepi16_epi32(_mm256_extracti128_si256(*src[s], 1)));
+                    *src[s] = _mm256_setzero_si256();
+                }
+            }
+        }
+        _mm256_storeu_si256((__m256i *)out.sum_T, sum_T[0]);
+        _mm256_storeu_si256((__m256i *)(out.sum_T + 8), sum_T[1]);
+        _mm256_storeu_si256((__m256i *)out.sum_TT, sum_TT[0]);
+        _mm256_storeu_si256((__m256i *)(out.sum_TT + 8), sum_TT[1]);
+        _mm256_storeu_si256((__m256i *)out.sum_ST, sum_ST[0]);
+        _mm256_storeu_si256((__m256i *)(out.sum_ST + 8), sum_ST[1]);
+    }
+
+    // 8 positions, same scheme in 128-bit registers
+    __attribute__((target("sse4.1"))) void block_sums_sse41(const SimdContext &ctx, int i, int j, BlockSums &out)
+    {
+        const __m128i ones = _mm_set1_epi16(0x0101);
+        __m128i sum_T[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+        __m128i sum_TT[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+        __m128i sum_ST[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+        __m128i acc_T = _mm_setzero_si128();
+        __m128i acc_TT = _mm_setzero_si128();
+        __m128i acc_ST = _mm_setzero_si128();
+
+        for (int k = 0; k < ctx.S_rows; ++k)
+        {
+            const uint8_t *t_row = ctx.T + (i + k) * ctx.T_stride + j;
+            const int16_t *pairs = ctx.S_pairs.data() + k * ctx.pairs_per_row;
+            for (int p = 0; p < ctx.pairs_per_row; ++p)
+            {
+                __m128i a = _mm_loadl_epi64((const __m128i *)(t_row + 2 * p));
+                __m128i b = _mm_loadl_epi64((const __m128i *)(t_row + 2 * p + 1));
+                __m128i x = _mm_unpacklo_epi8(a, b);
+                if (2 * p + 1 == ctx.S_cols)
+                {
+                    x = _mm_and_si128(x, _mm_set1_epi16(0x00ff));
+                }
+                acc_ST = _mm_add_epi16(acc_ST, _mm_maddubs_epi16(x, _mm_set1_epi16(pairs[p])));
+                acc_T = _mm_add_epi16(acc_T, _mm_maddubs_epi16(x, ones));
+                acc_TT = _mm_add_epi16(acc_TT, _mm_maddubs_epi16(x, x));
+            }
+            if ((k + 1) % ctx.rows_per_flush == 0 || k + 1 == ctx.S_rows)
+            {
+                __m128i *dst[3] = {sum_T, sum_TT, sum_ST};
+                __m128i *src[3] = {&acc_T, &acc_TT, &acc_ST};
+                for (int s = 0; s < 3; ++s)
+                {
+                    dst[s][0] = _mm_add_epi32(dst[s][0], _mm_cvtepi16_epi32(*src[s]));
+                    dst[s][1] = _mm_add_epi32(dst[s][1], _mm_cvtepi16_epi32(_mm_srli_si128(*src[s], 8)));
+                    *src[s] = _mm_setzero_si128();
+                }
+            }
+        }
+        _mm_storeu_si128((__m128i *)out.sum_T, sum_T[0]);
+        _mm_storeu_si128((__m128i *)(out.sum_T + 4), sum_T[1]);
+        _mm_storeu_si128((__m128i *)out.sum_TT, sum_TT[0]);
+        _mm_storeu_si128((__m128i *)(out.sum_TT + 4), sum_TT[1]);
+        _mm_storeu_si128((__m128i *)out.sum_ST, sum_ST[0]);
+        _mm_storeu_si128((__m128i *)(out.sum_ST + 4), sum_ST[1]);
+    }
+#endif
+
+    void score_block(const SimdContext &ctx, int i, int j, int count, const BlockSums &sums, LocalBest &local)
+    {
+        bool find_max = metric_find_max(ctx.metric);
+        long long n = static_cast<long long>(ctx.S_rows) * ctx.S_cols;
+        for (int p = 0; p < count; ++p)
+        {
+            double value = ctx.metric == Metric::PCC
+                               ? pcc_from_sums(n, sums.sum_T[p], ctx.sum_S, sums.sum_TT[p], ctx.sum_sq_S, sums.sum_ST[p])
+                               : ssd_from_sums(sums.sum_TT[p], ctx.sum_sq_S, sums.sum_ST[p]);
+            update_best(value, i, j + p, find_max, local.value, local.positions);
+        }
+    }
+
+    void scan_rows(const SimdContext &ctx, SimdLevel level, int max_j, int start_i, int end_i, LocalBest &local)
+    {
+        int width = level == SimdLevel::AVX2 ? 16 : level == SimdLevel::SSE41 ? 8 : 0;
+        BlockSums sums;
+        for (int i = start_i; i < end_i; ++i)
+        {
+            int j = 0;
+#ifdef SIMD_X86
+            for (; width > 0 && j + width <= max_j; j += width)
+            {
+                if (level == SimdLevel::AVX2)
+                {
+                    block_sums_avx2(ctx, i, j, sums);
+                }
+                else
+                {
+                    block_sums_sse41(ctx, i, j, sums);
+                }
+                score_block(ctx, i, j, width, sums, local);
+            }
+#endif
+            for (; j < max_j; j += max_block)
+            {
+                int count = std::min(max_block, max_j - j);
+                block_sums_scalar(ctx, i, j, count, sums);
+                score_block(ctx, i, j, count, sums, local);
+            }
+        }
+    }
+}
+
+void compute_simd(const Matrix &S_matrix, const Matrix &T_matrix, Metric metric,
+                  std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                  SimdLevel level, ThreadPool *pool)
+{
+    validate_dimensions(S_matrix, T_matrix);
+    require_pcc_or_ssd(metric, "simd");
+    int S_rows = S_matrix.rows(), S_cols = S_matrix.cols();
+    int T_rows = T_matrix.rows(), T_cols = T_matrix.cols();
+    std::vector<int> S = S_matrix.to_vector();
+
+    // 16-bit lanes hold one template row of 9*9 products; wider templates stay scalar
+    if (81 * S_cols > 32767)
+    {
+        level = SimdLevel::Scalar;
+    }
+
+    // Vector loads may run up to one byte past a row; Matrix row padding and its
+    // zeroed tail keep them in bounds
+    Matrix T8 = T_matrix.as_width(ElementWidth::UInt8);
+
+    SimdContext ctx;
+    ctx.T = T8.row_bytes(0);
+    ctx.T_stride = T8.stride();
+    ctx.S_rows = S_rows;
+    ctx.S_cols = S_cols;
+    ctx.S = S.data();
+    ctx.metric = metric;
+    ctx.pairs_per_row = (S_cols + 1) / 2;
+    ctx.rows_per_flush = std::max(1, 32767 / (81 * S_cols));
+    ctx.S_pairs.resize(static_cast<size_t>(S_rows) * ctx.pairs_per_row);
+    ctx.sum_S = 0;
+    ctx.sum_sq_S = 0;
+    for (int k = 0; k < S_rows; ++k)
+    {
+        for (int p = 0; p < ctx.pairs_per_row; ++p)
+        {
+            int lo = S[k * S_cols + 2 * p];
+            int hi = 2 * p + 1 < S_cols ? S[k * S_cols + 2 * p + 1] : 0;
+            ctx.S_pairs[k * ctx.pairs_per_row + p] = static_cast<int16_t>(lo | (hi << 8));
+        }
+    }
+    for (int v : S)
+    {
+        ctx.sum_S += v;
+        ctx.sum_sq_S += v * v;
+    }
+
+    int max_i = T_rows - S_rows + 1;
+    int max_j = T_cols - S_cols + 1;
+    parallel_bands(max_i, threads_count, metric_find_max(metric),
+                   [&](int start_i, int end_i, LocalBest &local)
+                   {
+                       scan_rows(ctx, level, max_j, start_i, end_i, local);
+                   },
+                   best_positions, best_value, pool);
+}
+
+void compute_simd(const Matrix &S, const Matrix &T, Metric metric,
+                  std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                  ThreadPool *pool)
+{
+    compute_simd(S, T, metric, best_positions, best_value, threads_count, detect_simd_level(), pool);
+}
@@ -16,3 +16,9 @@ double compute_ssd(const std::vector<int> &X, const std::vector<int> &Y)
     }
     return ssd;
 }
+
+// SSD from raw window sums: ΣX² - 2ΣXY + ΣY²
+double ssd_from_sums(long long sum_XX, long long sum_YY, long long sum_XY)
+{
+    return static_cast<double>(sum_XX - 2 * sum_XY + sum_YY);
+}
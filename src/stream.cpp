@@ -0,0 +1,279 @@
+#include "stream.hpp"
+#include "utils.hpp"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RowStream::RowStream(const std::string &filename, int rows, int cols)
+    : filename_(filename), rows_(rows), cols_(cols), values_(cols + 1)
+{
+    if (fs::path(filename).extension() != ".bin")
+    {
+        text_.open(filename);
+        if (!text_.is_open())
+        {
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        return;
+    }
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || pread(fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)))
+    {
+        close(fd_);
+        throw std::runtime_error("Binary matrix file is truncated: " + filename);
+    }
+    try
+    {
+        validate_matrix_header(header_, st.st_size, filename);
+    }
+    catch (...)
+    {
+        close(fd_);
+        throw;
+    }
+    if (header_.rows != rows || header_.cols != cols)
+    {
+        close(fd_);
+        throw std::runtime_error("Array dimensions do not match filename: " + filename);
+    }
+}
+
+RowStream::~RowStream()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+void RowStream::read(Matrix &band, int first, int count)
+{
+    if (next_row_ + count > rows_)
+    {
+        throw std::runtime_error("Read past the last row of file: " + filename_);
+    }
+    if (fd_ >= 0)
+    {
+        read_binary(band, first, count);
+    }
+    else
+    {
+        read_text(band, first, count);
+    }
+    next_row_ += count;
+}
+
+void RowStream::read_text(Matrix &band, int first, int count)
+{
+    std::string error;
+    for (int k = 0; k < count; ++k)
+    {
+        if (!std::getline(text_, line_))
+        {
+            throw std::runtime_error("Array dimensions do not match filename: " + filename_);
+        }
+        size_t length = line_.size();
+        if (length > 0 && line_[length - 1] == '\r')
+        {
+            --length;
+        }
+        int cols = parse_line(line_.data(), line_.data() + length, values_.data(), cols_ + 1, error);
+        if (cols < 0)
+        {
+            throw std::runtime_error(error + " in file: " + filename_);
+        }
+        if (cols != cols_)
+        {
+            throw std::runtime_error("Array dimensions do not match filename: " + filename_);
+        }
+        band.pack_row(first + k, values_.data());
+    }
+    // Extra rows after the last one are rejected, as load_matrix does
+    if (next_row_ + count == rows_ && std::getline(text_, line_))
+    {
+        throw std::runtime_error("Array dimensions do not match filename: " + filename_);
+    }
+}
+
+void RowStream::read_binary(Matrix &band, int first, int count)
+{
+    // One pread per band, then repack into the band's element width
+    const size_t stride = header_.stride;
+    raw_.resize(stride * count + Matrix::alignment);
+    off_t offset = sizeof(MatrixFileHeader) + stride * static_cast<off_t>(next_row_);
+    size_t done = 0;
+    while (done < stride * count)
+    {
+        ssize_t n = pread(fd_, raw_.data() + done, stride * count - done, offset + done);
+        if (n <= 0)
+        {
+            throw std::runtime_error("Failed to read file: " + filename_);
+        }
+        done += n;
+    }
+    Matrix rows(count, cols_, static_cast<ElementWidth>(header_.element_width), stride, raw_.data(), nullptr);
+    for (int k = 0; k < count; ++k)
+    {
+        rows.unpack_row(k, 0, cols_, values_.data());
+        band.pack_row(first + k, values_.data());
+    }
+}
+
+namespace
+{
+    // Loads the next band on its own pthread while the workers score the current one
+    struct BandLoad
+    {
+        RowStream *stream;
+        const Matrix *previous; // source of the overlap rows, read-only meanwhile
+        Matrix *band;
+        int overlap, fresh;
+        double seconds;
+        std::exception_ptr error;
+    };
+
+    void load_band(BandLoad &load)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            // 重疊列直接從上一個區段複製
+            const int first = load.previous ? load.previous->rows() - load.overlap : 0;
+            for (int k = 0; load.previous && k < load.overlap; ++k)
+            {
+                std::memcpy(load.band->row_bytes(k), load.previous->row_bytes(first + k), load.band->stride());
+            }
+            load.stream->read(*load.band, load.previous ? load.overlap : 0, load.fresh);
+        }
+        catch (...)
+        {
+            load.error = std::current_exception();
+        }
+        auto finish = std::chrono::high_resolution_clock::now();
+        load.seconds = std::chrono::duration<double>(finish - start).count();
+    }
+
+    void *load_band_thread(void *arg)
+    {
+        load_band(*static_cast<BandLoad *>(arg));
+        return nullptr;
+    }
+}
+
+void compute_streaming(const Matrix &S, const std::string &T_file, int T_rows, int T_cols, Metric metric,
+                       ElementWidth width, int band_rows,
+                       std::vector<std::pair<int, int>> &best_positions, double &best_value, int threads_count,
+                       ThreadPool *pool, StreamStats *stats)
+{
+    if (S.empty() || T_rows <= 0 || T_cols <= 0 || S.rows() > T_rows || S.cols() > T_cols)
+    {
+        throw std::invalid_argument("Matrix dimensions are invalid");
+    }
+    const int overlap = S.rows() - 1;
+    const int max_i = T_rows - S.rows() + 1;
+    if (band_rows <= 0)
+    {
+        band_rows = static_cast<int>((64u << 20) / Matrix::row_stride(T_cols, width));
+    }
+    band_rows = std::max(1, std::min(band_rows, max_i));
+
+    RowStream stream(T_file, T_rows, T_cols);
+    // 雙緩衝：一個計算、一個載入
+    Matrix buffers[2] = {Matrix(band_rows + overlap, T_cols, width), Matrix(band_rows + overlap, T_cols, width)};
+    // Shorter last band: a view over the first rows of its buffer
+    auto view = [&](int slot, int rows)
+    {
+        const Matrix &buffer = buffers[slot];
+        return Matrix(rows, T_cols, width, buffer.stride(), buffer.row_bytes(0), nullptr);
+    };
+
+    StreamStats local_stats;
+    local_stats.band_rows = band_rows;
+    local_stats.buffer_bytes = 2 * buffers[0].bytes();
+
+    const bool find_max = metric_find_max(metric);
+    best_value = find_max ? -std::numeric_limits<double>::max() : std::numeric_limits<double>::max();
+    best_positions.clear();
+
+    int band_start = 0; // first output row of the current band
+    Matrix current = view(0, std::min(band_rows, max_i) + overlap);
+    BandLoad first{&stream, nullptr, &buffers[0], 0, current.rows(), 0.0, nullptr};
+    load_band(first);
+    local_stats.load_seconds += first.seconds;
+    if (first.error)
+    {
+        std::rethrow_exception(first.error);
+    }
+
+    for (int slot = 0; band_start < max_i; slot ^= 1)
+    {
+        const int outputs = std::min(band_rows, max_i - band_start);
+        const int next_start = band_start + outputs;
+        const int next_outputs = std::min(band_rows, max_i - next_start);
+
+        BandLoad next{&stream, &current, &buffers[slot ^ 1], overlap, next_outputs, 0.0, nullptr};
+        pthread_t loader;
+        bool loading = false;
+        if (next_outputs > 0)
+        {
+            loading = pthread_create(&loader, nullptr, load_band_thread, &next) == 0;
+            if (!loading)
+            {
+                load_band(next); // no thread: load before scoring instead
+            }
+        }
+
+        // The loader writes into `next` and the other buffer: join it before unwinding
+        try
+        {
+            std::vector<std::pair<int, int>> band_positions;
+            double band_value;
+            compute_parallel(S, current, metric, band_positions, band_value, threads_count, pool);
+            for (auto &position : band_positions)
+            {
+                position.first += band_start;
+            }
+            merge_best(band_value, band_positions, find_max, best_value, best_positions);
+        }
+        catch (...)
+        {
+            if (loading)
+            {
+                pthread_join(loader, nullptr);
+            }
+            throw;
+        }
+        local_stats.bands++;
+
+        if (next_outputs > 0)
+        {
+            auto wait_start = std::chrono::high_resolution_clock::now();
+            if (loading)
+            {
+                pthread_join(loader, nullptr);
+            }
+            auto wait_end = std::chrono::high_resolution_clock::now();
+            local_stats.stall_seconds += std::chrono::duration<double>(wait_end - wait_start).count();
+            local_stats.load_seconds += next.seconds;
+            if (next.error)
+            {
+                std::rethrow_exception(next.error);
+            }
+            current = view(slot ^ 1, next_outputs + overlap);
+        }
+        band_start = next_start;
+    }
+
+    if (stats)
+    {
+        *stats = local_stats;
+    }
+}
@@ -0,0 +1,117 @@
+#include "thread_pool.hpp"
+#include <iostream>
+#include <stdexcept>
+
+void Latch::count_down()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--count_ == 0)
+    {
+        cv_.notify_all();
+    }
+}
+
+void Latch::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]
+             { return count_ <= 0; });
+}
+
+ThreadPool::ThreadPool(int num_workers)
+{
+    for (int t = 0; t < std::max(num_workers, 1); ++t)
+    {
+        auto worker = std::make_unique<Worker>();
+        if (pthread_create(&worker->thread, nullptr, worker_main, worker.get()) != 0)
+        {
+            std::cerr << "Unable to create thread " << t << std::endl;
+            break;
+        }
+        workers_.push_back(std::move(worker));
+    }
+    if (workers_.empty())
+    {
+        throw std::runtime_error("Failed to create any pool threads");
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (auto &worker : workers_)
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stop = true;
+        worker->cv.notify_one();
+    }
+    for (auto &worker : workers_)
+    {
+        pthread_join(worker->thread, nullptr);
+    }
+}
+
+void *ThreadPool::worker_main(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(worker->mutex);
+            worker->cv.wait(lock, [worker]
+                            { return worker->stop || !worker->tasks.empty(); });
+            if (worker->tasks.empty())
+            {
+                return nullptr; // stop requested and queue drained
+            }
+            task = std::move(worker->tasks.front());
+            worker->tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::submit(int worker, std::function<void()> task)
+{
+    Worker &w = *workers_[worker % workers_.size()];
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.tasks.push_back(std::move(task));
+    }
+    w.cv.notify_one();
+}
+
+void ThreadPool::run(int count, const std::function<void(int)> &body)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    Latch latch(count);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    for (int k = 0; k < count; ++k)
+    {
+        submit(k, [&, k]
+               {
+                   try
+                   {
+                       body(k);
+                   }
+                   catch (...)
+                   {
+                       std::lock_guard<std::mutex> lock(error_mutex);
+                       if (!error)
+                       {
+                           error = std::current_exception();
+                       }
+                   }
+                   latch.count_down();
+               });
+    }
+    latch.wait();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
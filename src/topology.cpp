@@ -0,0 +1,261 @@
+#include "topology.hpp"
+#include "compute.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+static std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty() || item == "\n")
+        {
+            continue;
+        }
+        size_t dash = item.find('-');
+        int first = std::stoi(item.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static bool read_line(const std::string &path, std::string &line)
+{
+    std::ifstream in(path);
+    return in && std::getline(in, line);
+}
+
+static int read_int(const std::string &path, int fallback)
+{
+    std::string line;
+    return read_line(path, line) && !line.empty() ? std::stoi(line) : fallback;
+}
+
+static Topology detect_topology()
+{
+    Topology topology;
+    const std::string root = "/sys/devices/system/cpu/";
+    std::string line;
+    std::vector<int> online;
+    if (read_line(root + "online", line))
+    {
+        online = parse_cpu_list(line);
+    }
+    if (online.empty())
+    {
+        for (int cpu = 0; cpu < std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)); ++cpu)
+        {
+            online.push_back(cpu);
+        }
+    }
+
+    // NUMA 節點: node*/cpulist; ids may be sparse (node0, node2)
+    std::map<int, int> node_of;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), [](unsigned char c)
+                         { return std::isdigit(c); }))
+        {
+            continue;
+        }
+        if (read_line(entry.path().string() + "/cpulist", line))
+        {
+            const int node = std::stoi(name.substr(4));
+            for (int cpu : parse_cpu_list(line))
+            {
+                node_of[cpu] = node;
+            }
+        }
+    }
+
+    std::map<std::pair<int, int>, int> core_ids; // (package, core_id) -> global core
+    std::map<int, int> siblings_seen;            // global core -> SMT siblings so far
+    std::set<int> nodes, packages;
+    for (int cpu : online)
+    {
+        const std::string topo = root + "cpu" + std::to_string(cpu) + "/topology/";
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = read_int(topo + "physical_package_id", 0);
+        int core_id = read_int(topo + "core_id", cpu);
+        auto key = std::make_pair(info.package, core_id);
+        if (!core_ids.count(key))
+        {
+            int next = core_ids.size();
+            core_ids[key] = next;
+        }
+        info.core = core_ids[key];
+        info.smt = siblings_seen[info.core]++;
+        info.node = node_of.count(cpu) ? node_of[cpu] : 0;
+        nodes.insert(info.node);
+        packages.insert(info.package);
+        topology.cpus.push_back(info);
+    }
+    topology.packages = packages.size();
+    topology.cores = core_ids.size();
+    topology.nodes = nodes.size();
+    return topology;
+}
+
+const Topology &Topology::detect()
+{
+    static const Topology topology = detect_topology();
+    return topology;
+}
+
+std::string Topology::describe() const
+{
+    std::ostringstream ss;
+    ss << packages << " package" << (packages > 1 ? "s" : "") << ", " << cores << " core" << (cores > 1 ? "s" : "")
+       << ", " << cpus.size() << " CPU" << (cpus.size() > 1 ? "s" : "") << ", " << nodes << " NUMA node"
+       << (nodes > 1 ? "s" : "");
+    return ss.str();
+}
+
+Placement parse_placement(const std::string &name)
+{
+    if (name == "none")
+    {
+        return Placement::None;
+    }
+    if (name == "compact")
+    {
+        return Placement::Compact;
+    }
+    if (name == "scatter")
+    {
+        return Placement::Scatter;
+    }
+    if (name == "physical")
+    {
+        return Placement::Physical;
+    }
+    if (name == "numa")
+    {
+        return Placement::NumaLocal;
+    }
+    throw std::runtime_error("Unknown placement: " + name);
+}
+
+const char *placement_name(Placement placement)
+{
+    switch (placement)
+    {
+    case Placement::Compact:
+        return "compact";
+    case Placement::Scatter:
+        return "scatter";
+    case Placement::Physical:
+        return "physical";
+    case Placement::NumaLocal:
+        return "numa";
+    default:
+        return "none";
+    }
+}
+
+std::vector<int> placement_cpus(const Topology &topology, Placement placement)
+{
+    std::vector<CpuInfo> cpus = topology.cpus;
+    switch (placement)
+    {
+    case Placement::None:
+        return {};
+    case Placement::Compact:
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b)
+                  { return std::tie(a.package, a.core, a.smt) < std::tie(b.package, b.core, b.smt); });
+        break;
+    case Placement::Physical:
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [](const CpuInfo &c)
+                                  { return c.smt > 0; }),
+                   cpus.end());
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b)
+                  { return std::tie(a.package, a.core) < std::tie(b.package, b.core); });
+        break;
+    case Placement::Scatter:
+    case Placement::NumaLocal:
+    {
+        // Scatter alternates sockets; NUMA-local alternates nodes, so k workers split
+        // evenly over the nodes and each band of T stays with its node
+        bool by_node = placement == Placement::NumaLocal;
+        std::map<int, int> rank; // position of each CPU within its socket or node
+        std::map<int, int> next;
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b)
+                  { return std::tie(a.smt, a.package, a.core) < std::tie(b.smt, b.package, b.core); });
+        for (const auto &c : cpus)
+        {
+            rank[c.cpu] = next[by_node ? c.node : c.package]++;
+        }
+        std::stable_sort(cpus.begin(), cpus.end(), [&](const CpuInfo &a, const CpuInfo &b)
+                         { return std::make_pair(rank[a.cpu], by_node ? a.node : a.package) <
+                                  std::make_pair(rank[b.cpu], by_node ? b.node : b.package); });
+        break;
+    }
+    }
+    std::vector<int> order;
+    for (const auto &c : cpus)
+    {
+        order.push_back(c.cpu);
+    }
+    return order;
+}
+
+std::vector<int> apply_placement(ThreadPool &pool, Placement placement)
+{
+    const Topology &topology = Topology::detect();
+    std::vector<int> cpus = placement_cpus(topology, placement);
+    // 每個 worker 各自設定親和性
+    pool.run(pool.size(), [&](int k)
+             {
+                 cpu_set_t set;
+                 CPU_ZERO(&set);
+                 if (cpus.empty())
+                 {
+                     for (const auto &c : topology.cpus)
+                     {
+                         CPU_SET(c.cpu, &set);
+                     }
+                 }
+                 else
+                 {
+                     CPU_SET(cpus[k % cpus.size()], &set);
+                 }
+                 pthread_setaffinity_np(pthread_self(), sizeof(set), &set); });
+    return cpus;
+}
+
+Matrix node_local_copy(const Matrix &T, int bands, ThreadPool *pool)
+{
+    Matrix copy = Matrix::uninitialized(T.rows(), T.cols(), T.width());
+    parallel_ranges(
+        T.rows(), bands,
+        [&](int, int begin, int end)
+        {
+            if (begin < end)
+            {
+                std::memcpy(copy.row_bytes(begin), T.row_bytes(begin), T.stride() * (end - begin));
+            }
+        },
+        pool);
+    return copy;
+}
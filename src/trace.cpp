@@ -0,0 +1,192 @@
+#include "trace.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <numeric>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Shared time origin, so several runs line up on one timeline
+static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+void RunTrace::begin()
+{
+    start_ = std::chrono::steady_clock::now();
+    origin = std::chrono::duration<double>(start_ - trace_epoch).count();
+    total = 0;
+    merge = 0;
+    workers.clear();
+}
+
+double RunTrace::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+static int open_counter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // 只量測呼叫的執行緒，任何 CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters()
+{
+    const uint64_t configs[4] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                 PERF_COUNT_HW_STALLED_CYCLES_BACKEND};
+    for (int k = 0; k < 4; ++k)
+    {
+        fds_[k] = open_counter(PERF_TYPE_HARDWARE, configs[k]);
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : fds_)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::read(WorkerTrace &worker) const
+{
+    long long *fields[4] = {&worker.cycles, &worker.instructions, &worker.llc_misses, &worker.stalled_cycles};
+    for (int k = 0; k < 4; ++k)
+    {
+        uint64_t values[3]; // value, time enabled, time running
+        if (fds_[k] < 0 || ::read(fds_[k], values, sizeof(values)) != sizeof(values) || values[2] == 0)
+        {
+            *fields[k] = -1;
+            continue;
+        }
+        // Scale up when the PMU was multiplexed between events
+        *fields[k] = static_cast<long long>(static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+}
+
+static std::string counter_str(long long value)
+{
+    return value < 0 ? "n/a" : std::to_string(value);
+}
+
+void print_trace_report(const RunTrace &trace, std::ostream &out)
+{
+    std::ios state(nullptr);
+    state.copyfmt(out);
+    out << std::fixed << std::setprecision(3);
+    out << "Trace " << trace.name << ": " << trace.workers.size() << " workers, total " << trace.total * 1e3
+        << " ms, merge " << trace.merge * 1e3 << " ms\n";
+    out << std::setw(6) << "worker" << std::setw(10) << "start ms" << std::setw(10) << "end ms" << std::setw(10)
+        << "busy ms" << std::setw(8) << "tiles" << std::setw(12) << "windows";
+    if (trace.counters)
+    {
+        out << std::setw(14) << "cycles" << std::setw(14) << "instr" << std::setw(6) << "IPC" << std::setw(12)
+            << "LLC miss" << std::setw(14) << "stalled";
+    }
+    out << "\n";
+
+    double max_busy = 0, sum_busy = 0, max_start = 0;
+    for (size_t w = 0; w < trace.workers.size(); ++w)
+    {
+        const WorkerTrace &worker = trace.workers[w];
+        max_busy = std::max(max_busy, worker.busy);
+        sum_busy += worker.busy;
+        max_start = std::max(max_start, worker.start);
+        out << std::setw(6) << w << std::setw(10) << worker.start * 1e3 << std::setw(10) << worker.end * 1e3
+            << std::setw(10) << worker.busy * 1e3 << std::setw(8) << worker.tiles << std::setw(12)
+            << worker.windows;
+        if (trace.counters)
+        {
+            out << std::setw(14) << counter_str(worker.cycles) << std::setw(14) << counter_str(worker.instructions)
+                << std::setw(6);
+            if (worker.cycles > 0 && worker.instructions >= 0)
+            {
+                out << std::setprecision(2) << 1.0 * worker.instructions / worker.cycles << std::setprecision(3);
+            }
+            else
+            {
+                out << "n/a";
+            }
+            out << std::setw(12) << counter_str(worker.llc_misses) << std::setw(14)
+                << counter_str(worker.stalled_cycles);
+        }
+        out << "\n";
+    }
+    double mean_busy = trace.workers.empty() ? 0 : sum_busy / trace.workers.size();
+    // 負載不平衡: 最忙 / 平均
+    out << "Load imbalance " << std::setprecision(2) << (mean_busy > 0 ? max_busy / mean_busy : 1.0)
+        << "x, last worker started at " << std::setprecision(3) << max_start * 1e3 << " ms, parallel efficiency "
+        << std::setprecision(1)
+        << (trace.total > 0 && !trace.workers.empty() ? 100.0 * sum_busy / (trace.total * trace.workers.size()) : 0.0)
+        << "%\n";
+    out.copyfmt(state);
+}
+
+void write_chrome_trace(const std::string &filename, const std::vector<RunTrace> &traces)
+{
+    fs::path path(filename);
+    if (path.has_parent_path())
+    {
+        fs::create_directories(path.parent_path());
+    }
+    std::ofstream out(filename, std::ios::trunc);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+    bool first = true;
+    auto event = [&](const std::string &body)
+    {
+        out << (first ? "\n" : ",\n") << "  {" << body << "}";
+        first = false;
+    };
+    auto us = [](double seconds)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3) << seconds * 1e6;
+        return ss.str();
+    };
+    for (size_t r = 0; r < traces.size(); ++r)
+    {
+        const RunTrace &trace = traces[r];
+        const std::string pid = std::to_string(r + 1);
+        event("\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " + pid + ", \"args\": {\"name\": \"" +
+              trace.name + "\"}");
+        for (size_t w = 0; w < trace.workers.size(); ++w)
+        {
+            const WorkerTrace &worker = trace.workers[w];
+            const std::string tid = std::to_string(w);
+            event("\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " + pid + ", \"tid\": " + tid +
+                  ", \"args\": {\"name\": \"worker " + tid + "\"}");
+            for (const auto &[begin, end] : worker.spans)
+            {
+                event("\"ph\": \"X\", \"name\": \"tile\", \"pid\": " + pid + ", \"tid\": " + tid +
+                      ", \"ts\": " + us(trace.origin + begin) + ", \"dur\": " + us(end - begin));
+            }
+        }
+        const std::string merge_tid = std::to_string(trace.workers.size());
+        event("\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " + pid + ", \"tid\": " + merge_tid +
+              ", \"args\": {\"name\": \"merge\"}");
+        event("\"ph\": \"X\", \"name\": \"merge\", \"pid\": " + pid + ", \"tid\": " + merge_tid +
+              ", \"ts\": " + us(trace.origin + trace.total - trace.merge) + ", \"dur\": " + us(trace.merge));
+    }
+    out << "\n]}\n";
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
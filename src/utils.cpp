@@ -1,8 +1,13 @@
 #include "utils.hpp"
+#include "compute.hpp"
+#include "matfile.hpp"
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
 
 void parse_filename(const std::string &filename, int &rows, int &cols)
 {
-    std::regex pattern(R"(_(\d+)_(\d+)\.txt$)");
+    std::regex pattern(R"(_(\d+)_(\d+)\.(txt|bin)$)");
     std::smatch match;
     if (std::regex_search(filename, match, pattern))
     {
@@ -71,27 +76,81 @@ void find_files(const std::string &folder_path, std::string &S_file, std::string
                 int &S_rows, int &S_cols, int &T_rows, int &T_cols)
 {
     std::string folder_name = fs::path(folder_path).filename().string();
+    std::string S_bin, T_bin;
     for (const auto &entry : fs::directory_iterator(folder_path))
     {
         std::string filename = entry.path().filename().string();
+        std::string extension = entry.path().extension().string();
+        if (extension != ".txt" && extension != ".bin")
+        {
+            continue;
+        }
+        bool binary = extension == ".bin";
         if (filename.find("S" + folder_name + "_") == 0)
         {
-            S_file = entry.path().string();
+            (binary ? S_bin : S_file) = entry.path().string();
             parse_filename(filename, S_rows, S_cols);
         }
         else if (filename.find("T" + folder_name + "_") == 0)
         {
-            T_file = entry.path().string();
+            (binary ? T_bin : T_file) = entry.path().string();
             parse_filename(filename, T_rows, T_cols);
         }
     }
 
+    // 優先使用未過期的二進位快取
+    if (S_file.empty() ? !S_bin.empty() : binary_is_fresh(S_file))
+    {
+        S_file = S_file.empty() ? S_bin : binary_path_for(S_file);
+    }
+    if (T_file.empty() ? !T_bin.empty() : binary_is_fresh(T_file))
+    {
+        T_file = T_file.empty() ? T_bin : binary_path_for(T_file);
+    }
+
     if (S_file.empty() || T_file.empty())
     {
         throw std::runtime_error("Could not find S or T file in folder: " + folder_path);
     }
 }
 
+std::vector<std::string> find_matrix_files(const std::string &folder_path, char prefix)
+{
+    std::regex pattern(std::string("^") + prefix + R"(.*_(\d+)_(\d+)\.(txt|bin)$)");
+    std::vector<std::string> files;
+    for (const auto &entry : fs::directory_iterator(folder_path))
+    {
+        std::string filename = entry.path().filename().string();
+        if (!std::regex_match(filename, pattern))
+        {
+            continue;
+        }
+        std::string file = entry.path().string();
+        if (entry.path().extension() == ".txt" && binary_is_fresh(file))
+        {
+            continue; // the .bin is listed on its own
+        }
+        if (entry.path().extension() == ".bin" && fs::exists(fs::path(file).replace_extension(".txt")) &&
+            !binary_is_fresh(fs::path(file).replace_extension(".txt").string()))
+        {
+            continue; // stale cache
+        }
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::vector<std::string> find_template_files(const std::string &folder_path)
+{
+    std::vector<std::string> files = find_matrix_files(folder_path, 'S');
+    if (files.empty())
+    {
+        throw std::runtime_error("Could not find any template files in folder: " + folder_path);
+    }
+    return files;
+}
+
 void read_arrays(const std::string &S_file, const std::string &T_file,
                  int S_rows, int S_cols, int T_rows, int T_cols,
                  std::vector<int> &S, std::vector<int> &T)
@@ -100,6 +159,244 @@ void read_arrays(const std::string &S_file, const std::string &T_file,
     read_array(T_file, T, T_rows, T_cols);
 }
 
+int parse_line(const char *p, const char *end, uint8_t *out, int capacity, std::string &error)
+{
+    int count = 0;
+    while (true)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        bool negative = p < end && *p == '-';
+        if (negative || (p < end && *p == '+'))
+        {
+            ++p;
+        }
+        if (p == end || *p < '0' || *p > '9')
+        {
+            error = "Invalid number format";
+            return -1;
+        }
+        int val = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            val = std::min(val * 10 + (*p - '0'), 100);
+            ++p;
+        }
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        if (negative || val > 9)
+        {
+            error = "Values must be between 0 and 9";
+            return -1;
+        }
+        if (count < capacity)
+        {
+            out[count] = static_cast<uint8_t>(val);
+        }
+        ++count;
+        if (p == end)
+        {
+            return count;
+        }
+        if (*p != ',')
+        {
+            error = "Invalid number format";
+            return -1;
+        }
+        ++p;
+        if (p == end)
+        {
+            return count; // trailing comma, as std::getline tokenising allows
+        }
+    }
+}
+
+void parse_chunk(ParseChunk &chunk, Matrix &matrix, int expected_cols, const std::function<void(int)> &progress)
+{
+    const int progress_rows = 64;
+    std::vector<uint8_t> row(expected_cols + 1);
+    int r = chunk.first_row;
+    for (const char *p = chunk.begin; p < chunk.end;)
+    {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+        const char *line_end = nl ? nl : chunk.end;
+        const char *next = nl ? nl + 1 : chunk.end;
+        if (line_end > p && line_end[-1] == '\r')
+        {
+            --line_end;
+        }
+        int cols = parse_line(p, line_end, row.data(), expected_cols + 1, chunk.error);
+        if (cols < 0)
+        {
+            return;
+        }
+        if (chunk.cols == -1)
+        {
+            chunk.cols = cols;
+        }
+        else if (cols != chunk.cols)
+        {
+            chunk.error = "Inconsistent number of columns";
+            return;
+        }
+        if (cols != expected_cols)
+        {
+            chunk.error = "Unexpected number of columns";
+            return;
+        }
+        if (r < matrix.rows())
+        {
+            matrix.pack_row(r, row.data());
+        }
+        ++r;
+        ++chunk.rows;
+        p = next;
+        if (progress && chunk.rows % progress_rows == 0)
+        {
+            progress(chunk.rows);
+        }
+    }
+    if (progress)
+    {
+        progress(chunk.rows);
+    }
+}
+
+std::vector<ParseChunk> split_text_chunks(const char *begin, const char *end, int num_chunks, int threads_count,
+                                          ThreadPool *pool)
+{
+    if (begin != end && end[-1] == '\n')
+    {
+        --end; // the final newline does not start another row
+    }
+
+    // 以換行切分區塊
+    std::vector<ParseChunk> chunks;
+    const char *p = begin;
+    for (int t = 0; t < num_chunks && p < end; ++t)
+    {
+        const char *chunk_end = t == num_chunks - 1 ? end : begin + (end - begin) * (t + 1) / num_chunks;
+        if (chunk_end < p)
+        {
+            chunk_end = p;
+        }
+        const char *nl = chunk_end < end ? static_cast<const char *>(std::memchr(chunk_end, '\n', end - chunk_end)) : nullptr;
+        chunk_end = nl ? nl + 1 : end;
+        ParseChunk chunk;
+        chunk.begin = p;
+        chunk.end = chunk_end;
+        chunk.first_row = 0;
+        chunks.push_back(chunk);
+        p = chunk_end;
+    }
+
+    // Pass 1: count rows per chunk to find where each chunk starts
+    parallel_ranges(chunks.size(), threads_count,
+                    [&](int, int first, int last)
+                    {
+                        for (int c = first; c < last; ++c)
+                        {
+                            const char *q = chunks[c].begin;
+                            int rows = 0;
+                            while (q < chunks[c].end)
+                            {
+                                const char *nl = static_cast<const char *>(std::memchr(q, '\n', chunks[c].end - q));
+                                ++rows;
+                                q = nl ? nl + 1 : chunks[c].end;
+                            }
+                            chunks[c].lines = rows;
+                        }
+                    },
+                    pool);
+    int rows = 0;
+    for (auto &chunk : chunks)
+    {
+        chunk.first_row = rows;
+        rows += chunk.lines;
+    }
+    return chunks;
+}
+
+int check_chunks(const std::vector<ParseChunk> &chunks, const std::string &filename)
+{
+    int cols = -1;
+    for (const auto &chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            throw std::runtime_error(chunk.error + " in file: " + filename);
+        }
+        if (cols == -1)
+        {
+            cols = chunk.cols;
+        }
+        else if (chunk.cols != cols)
+        {
+            throw std::runtime_error("Inconsistent number of columns in file: " + filename);
+        }
+    }
+    return cols;
+}
+
+Matrix load_matrix(const std::string &filename, int expected_rows, int expected_cols,
+                   ElementWidth width, int threads_count, ThreadPool *pool)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    MappedFile file(filename);
+    int num_chunks = static_cast<int>(resolve_thread_count(threads_count, std::max(1, expected_rows), pool));
+    std::vector<ParseChunk> chunks = split_text_chunks(file.data, file.data + file.size, num_chunks, threads_count, pool);
+    int rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().lines;
+    if (rows != expected_rows)
+    {
+        throw std::runtime_error("Array dimensions do not match filename: " + filename);
+    }
+
+    // Pass 2: parse digits straight into the matrix
+    Matrix matrix(expected_rows, expected_cols, width);
+    parallel_ranges(chunks.size(), threads_count,
+                    [&](int, int first, int last)
+                    {
+                        for (int c = first; c < last; ++c)
+                        {
+                            parse_chunk(chunks[c], matrix, expected_cols);
+                        }
+                    },
+                    pool);
+    int cols = check_chunks(chunks, filename);
+
+    auto finish = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(finish - start).count();
+    double mb = file.size / (1024.0 * 1024.0);
+    std::ostringstream throughput;
+    throughput << std::fixed << std::setprecision(2) << mb << " MB, " << (seconds > 0 ? mb / seconds : 0.0) << " MB/s";
+    std::cout << "Read " << rows << " rows and " << cols << " columns from file: " << filename
+              << " (" << throughput.str() << ")" << std::endl;
+    return matrix;
+}
+
+Matrix read_matrix(const std::string &filename, int rows, int cols, ElementWidth width, int threads_count,
+                   ThreadPool *pool)
+{
+    if (fs::path(filename).extension() == ".bin")
+    {
+        return map_binary_matrix(filename, rows, cols).as_width(width);
+    }
+    return load_matrix(filename, rows, cols, width, threads_count, pool);
+}
+
+void read_arrays(const std::string &S_file, const std::string &T_file,
+                 int S_rows, int S_cols, int T_rows, int T_cols,
+                 Matrix &S, Matrix &T, ElementWidth width, ThreadPool *pool)
+{
+    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    S = read_matrix(S_file, S_rows, S_cols, width, 1, pool);
+    T = read_matrix(T_file, T_rows, T_cols, width, num_cores, pool);
+}
+
 std::string get_positions_str(const std::vector<std::pair<int, int>> &positions)
 {
     std::string ss;
@@ -130,6 +427,23 @@ void display_results(const std::string &method, const std::vector<std::pair<int,
     std::cout << "----------------------------------------\n";
 }
 
+void display_ranked_results(const std::string &method, const std::vector<ScoredPosition> &results, double time)
+{
+    std::cout << "----------------------------------------\n";
+    std::cout << "Ranked results for " << method << ":\n";
+    if (results.empty())
+    {
+        std::cout << "No positions found.\n";
+    }
+    for (const auto &result : results)
+    {
+        std::cout << std::fixed << std::setprecision(4) << result.value << " (" << result.i << "," << result.j << ")\n";
+    }
+    std::cout << "Computation time: " << std::fixed << std::setprecision(6)
+              << time << " seconds\n";
+    std::cout << "----------------------------------------\n";
+}
+
 void reset_csv(const std::string &data_path)
 {
     std::string csv_path = "outputs/";